@@ -0,0 +1,179 @@
+#include <stdlib.h>
+
+#include <iostream>
+#include <vector>
+#include <unordered_set>
+#include <chrono>
+#include <cstdint>
+
+#include "converter.h"
+#include "config.h"
+
+/**
+ * Micro benchmarks for the inner loops of the Sokoban solver. The program loads a level,
+ * collects a sample of configurations reachable from the initial configuration and measures
+ * the throughput of the individual building blocks of the search on this sample.
+ */
+
+// Number of configurations in the sample
+static const uint64_t SAMPLE_SIZE = 20000;
+
+// Minimum run time of each measurement (in seconds)
+static const double MIN_TIME = 1.0;
+
+/**
+ * Collect up to 'n' configurations in breadth first order, starting with 'conf'.
+ */
+static std::vector<uint64_t> collectSample(Config *conf, uint64_t n)
+{
+	std::vector<uint64_t> sample;
+	std::unordered_set<uint64_t> seen;
+	sample.push_back(conf->getConfig());
+	seen.insert(conf->getConfig());
+	uint64_t nBoxes = Config::numBoxes();
+	for (uint64_t i = 0; (i < sample.size()) && (sample.size() < n); i++)
+	{
+		Config c(sample[i]);
+		for (uint64_t box = 0; box < nBoxes; box++)
+		{
+			for (uint64_t dir = 0; dir < 4; dir++)
+			{
+				uint64_t next = c.getNextConfig(box, dir, NULL);
+				if ((next != Config::NONE) && seen.insert(next).second)
+					sample.push_back(next);
+			}
+		}
+	}
+	if (sample.size() > n)
+		sample.resize(n);
+	return sample;
+}
+
+/**
+ * Execute 'body' on the whole sample repeatedly until at least MIN_TIME seconds have
+ * passed. Returns the number of executions per second; 'body' returns the number of
+ * operations it performed.
+ */
+template <class Body>
+static double measure(const std::vector<uint64_t> &sample, Body body)
+{
+	uint64_t ops = 0;
+	auto ta = std::chrono::high_resolution_clock::now();
+	std::chrono::duration<double> time;
+	do
+	{
+		for (uint64_t i = 0; i < sample.size(); i++)
+			ops += body(sample[i]);
+		time = std::chrono::high_resolution_clock::now() - ta;
+	} while (time.count() < MIN_TIME);
+	return ops / time.count();
+}
+
+/**
+ * Measure the throughput of the successor generation: for each configuration of the
+ * sample, a Config object is created and all moves of all boxes are tried.
+ */
+static void benchSuccessors(const std::vector<uint64_t> &sample)
+{
+	uint64_t nBoxes = Config::numBoxes();
+	double rate = measure(sample, [nBoxes](uint64_t no) {
+		uint64_t n = 0;
+		Config c(no);
+		for (uint64_t box = 0; box < nBoxes; box++)
+		{
+			for (uint64_t dir = 0; dir < 4; dir++)
+			{
+				uint64_t newBox;
+				if (c.getNextConfig(box, dir, &newBox) != Config::NONE)
+					n++;
+			}
+		}
+		return n;
+	});
+	std::cout << "  successors/s: " << (uint64_t)rate << std::endl;
+}
+
+/**
+ * Measure the throughput of the conversion between box positions and configuration
+ * numbers (ranking and unranking) on the box configurations of the sample.
+ */
+static void benchRanking(const std::vector<uint64_t> &sample)
+{
+	uint64_t nBoxConfigs = Converter::getNumConfigs();
+	uint64_t nBoxes = Config::numBoxes();
+	std::vector<uint64_t> nos(sample.size());
+	std::vector<uint64_t> pos(sample.size() * nBoxes);
+	for (uint64_t i = 0; i < sample.size(); i++)
+	{
+		nos[i] = sample[i] % nBoxConfigs;
+		Converter::noToConfig(nos[i], &pos[i * nBoxes]);
+	}
+
+	uint64_t sum = 0;
+	double rate = measure(nos, [&](uint64_t no) {
+		Converter::noToConfig(no, &pos[0]);
+		sum += pos[0];
+		return 1;
+	});
+	std::cout << "  unranks/s:    " << (uint64_t)rate << std::endl;
+
+	for (uint64_t i = 0; i < sample.size(); i++)
+		Converter::noToConfig(nos[i], &pos[i * nBoxes]);
+	uint64_t i = 0;
+	rate = measure(nos, [&](uint64_t no) {
+		sum += Converter::configToNo(&pos[i * nBoxes]);
+		i = (i + 1) % nos.size();
+		return 1;
+	});
+	std::cout << "  ranks/s:      " << (uint64_t)rate << std::endl;
+
+	// Batched unranking: groups of BATCH numbers per call
+	const uint64_t BATCH = 256;
+	std::vector<uint64_t> starts;
+	for (uint64_t j = 0; j + BATCH <= nos.size(); j += BATCH)
+		starts.push_back(j);
+	rate = measure(starts, [&](uint64_t start) {
+		Converter::noToConfigs(&nos[start], BATCH, &pos[start * nBoxes]);
+		return BATCH;
+	});
+	std::cout << "  batch unranks/s: " << (uint64_t)rate << std::endl;
+
+	// Incremental ranking: move the first box to the next free field
+	for (uint64_t j = 0; j < sample.size(); j++)
+		Converter::noToConfig(nos[j], &pos[j * nBoxes]);
+	i = 0;
+	rate = measure(nos, [&](uint64_t no) {
+		uint64_t *p = &pos[i * nBoxes];
+		uint64_t newPos = p[0] + 1;
+		for (uint64_t b = 1; b < nBoxes && p[b] == newPos; b++)
+			newPos++;
+		sum += Converter::moveToNo(no, p, 0, newPos);
+		i = (i + 1) % nos.size();
+		return 1;
+	});
+	std::cout << "  incremental ranks/s: " << (uint64_t)rate << std::endl;
+
+	if (sum == 0)
+		std::cout << std::endl;
+}
+
+/**
+ * Main program. Invocation:
+ *    benchmark <level-file>
+ */
+int main(int argc, char **argv)
+{
+	if (argc != 2)
+	{
+		std::cerr << "Usage: benchmark <level-file>" << std::endl;
+		exit(1);
+	}
+
+	Config *conf = Config::init(argv[1]);
+	std::vector<uint64_t> sample = collectSample(conf, SAMPLE_SIZE);
+	std::cout << argv[1] << " (" << sample.size() << " configurations)" << std::endl;
+	benchSuccessors(sample);
+	benchRanking(sample);
+	delete conf;
+	return 0;
+}
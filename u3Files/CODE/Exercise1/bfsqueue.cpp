@@ -3,8 +3,12 @@
 #include <string>
 #include <iostream>
 #include <cstdio>
-#include <fstream>
 #include <atomic>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #if defined(WIN32) || defined(_WIN32) || defined(__WIN32__) || defined(__NT__)
 #include <Windows.h>
@@ -16,21 +20,99 @@
 
 using namespace std;
 
+// Number of bits required to store the values 0 ... n-1
+static uint64_t bitsFor(uint64_t n)
+{
+	return (n <= 1) ? 0 : 64 - __builtin_clzll(n-1);
+}
+
+// Sequential writer for a bit stream in an array of 64-bit words
+class BitWriter
+{
+ public:
+	std::vector<uint64_t> & words;
+	uint64_t bit;
+
+	BitWriter(std::vector<uint64_t> & w) : words(w), bit(0) { words.clear(); }
+
+	// Append the 'n' lower bits (n <= 64) of 'v'
+	void put(uint64_t v, uint64_t n)
+	{
+		if (n == 0)
+			return;
+		if (n < 64)
+			v &= ((uint64_t)1 << n) - 1;
+		uint64_t off = bit & 63;
+		if (off == 0)
+			words.push_back(0);
+		words.back() |= v << off;
+		if (off + n > 64)
+			words.push_back(v >> (64 - off));
+		bit += n;
+	}
+
+	// Append the Elias gamma code of v >= 1: floor(log2 v) one bits, a zero bit, and the
+	// bits of v below its highest bit.
+	void putGamma(uint64_t v)
+	{
+		uint64_t n = 63 - __builtin_clzll(v);
+		for (uint64_t i = 0; i < n; i++)
+			put(1, 1);
+		put(0, 1);
+		put(v, n);
+	}
+};
+
+// Sequential reader for a bit stream written by BitWriter
+class BitReader
+{
+ public:
+	const uint64_t * words;
+	uint64_t bit;
+
+	BitReader(const uint64_t * w) : words(w), bit(0) {}
+
+	// Read 'n' bits (n <= 64)
+	uint64_t get(uint64_t n)
+	{
+		if (n == 0)
+			return 0;
+		uint64_t i = bit >> 6;
+		uint64_t off = bit & 63;
+		uint64_t v = words[i] >> off;
+		if (off + n > 64)
+			v |= words[i+1] << (64 - off);
+		bit += n;
+		return (n == 64) ? v : v & (((uint64_t)1 << n) - 1);
+	}
+
+	// Read an Elias gamma code (see BitWriter::putGamma())
+	uint64_t getGamma()
+	{
+		uint64_t n = 0;
+		while (get(1) != 0)
+			n++;
+		return ((uint64_t)1 << n) | get(n);
+	}
+};
+
 /**
  * Data structure for supporting the breadth first search. The data structure primarily implements
- * a queue for configurations, connected with a set (bit set) storing the configurations that have
- * already been visited.
+ * a queue for configurations, connected with a set (see VisitedSet) storing the configurations that
+ * have already been visited.
  */
 
 
 /**
- * Constructor: Create a queue/bit set for configuration numbers between
- * 0 and numConf-1.
+ * Constructor: Create a queue/visited set for configuration numbers between
+ * 0 and numConf-1 and box numbers between 0 and numBoxes-1, with per-thread buffers
+ * for 'nThreads' threads. 'kind' selects the implementation of the visited set.
  */
-BFSQueue::BFSQueue(uint64_t numConf)
-	: file("sokoban.tmp", ios::out|ios::in|ios::trunc|ios::binary) // open a temporary file
+BFSQueue::BFSQueue(uint64_t numConf, uint64_t numBoxes, int nThreads, VisitedSet::Kind kind)
 {
-	if (!file.is_open()) {
+	// Open a temporary file
+	file = open("sokoban.tmp", O_RDWR|O_CREAT|O_TRUNC, 0600);
+	if (file < 0) {
 		cerr << "Cannot open tmp file 'sokoban.tmp'\n";
 		exit(1);
 	}
@@ -38,17 +120,26 @@ BFSQueue::BFSQueue(uint64_t numConf)
 	// When using the Windows OS, you may need to delete this statement.
 	std::remove("sokoban.tmp");
 
+	configBits = bitsFor(numConf);
+	boxBits = bitsFor(numBoxes);
+
 	// Allocate arrays and initialize them with NULL. This initialization is caused by the
-	// empty pair of parentheses () at the end of the 'new' operator.
-	queue_length = qIndex1(numConf-1) + 1;
-	queue[0] = new Entry *[queue_length]();
-	queue[1] = new Entry *[queue_length]();
-	bitset_length = bsIndex1(numConf-1) + 1;
-	bitset = new volatile uint64_t*[bitset_length]();
+	// empty pair of parentheses () at the end of the 'new' operator. A tree depth has at most
+	// numConf entries, so the predecessor index needs at most configBits bits.
+	queue_length = (numConf-1) / makeFormat(configBits).perBlock + 1;
+	queue[0] = new std::atomic<std::atomic<uint64_t> *>[queue_length]();
+	queue[1] = new std::atomic<std::atomic<uint64_t> *>[queue_length]();
+	visited = VisitedSet::create(kind, numConf);
+	autoSelect = (kind == VisitedSet::AUTO);
+	rdFormat = makeFormat(0);
+	wrFormat = makeFormat(0);
 	wrPos = 0;
 	rdLength = 0;
 	depth = 0;
 	file_length = 0;
+	nBuffers = nThreads;
+	buffers = new Buffer[nBuffers];
+	sortBatches = false;
 }
 
 /**
@@ -56,82 +147,327 @@ BFSQueue::BFSQueue(uint64_t numConf)
  */
 BFSQueue::~BFSQueue()
 {
+	waitForWriter();
 	for (uint64_t i=0; i<queue_length; i++) {
 		delete[] queue[0][i];
 		delete[] queue[1][i];
 	}
-	for (uint64_t i=0; i<bitset_length; i++) {
-		delete[] bitset[i];
+	for (int t=0; t<nBuffers; t++) {
+		for (uint64_t * block : buffers[t].blocks)
+			delete[] block;
 	}
+	delete[] buffers;
 	delete[] queue[0];
 	delete[] queue[1];
-	delete[] bitset;
-	file.close();
+	delete visited;
+	close(file);
 }
 
 /**
- * Increase the tree depth by one. The previous write queue becomes the read queue for the
- * new tree depth. The old read queue is stored in a temporary file to determine the solution
- * path at the end.
+ * Increase the tree depth by one. The candidates in the per-thread buffers (see add())
+ * are merged into the write queue, and the previous write queue becomes the read queue
+ * for the new tree depth. The new read queue is stored in a temporary file to determine
+ * the solution path at the end. This is done by a background thread while the threads
+ * expand the new read queue; its memory is reused only after the export has finished,
+ * i.e., in the next call of pushDepth().
  */
 void BFSQueue::pushDepth()
 {
+	mergeBuffers();
+
+	// Automatic selection of the visited set: replace the sparse set by a dense set as soon
+	// as a dense set with the same contents needs less memory, i.e., the visited
+	// configurations are dense enough.
+	if (autoSelect) {
+		SparseVisitedSet * sparse = (SparseVisitedSet *)visited;
+		if (sparse->memory() > sparse->denseMemory()) {
+			visited = sparse->toDense();
+			delete sparse;
+			autoSelect = false;
+		}
+	}
+
+	// Sorting the batches only pays off if the visited set does not fit into the cache
+	sortBatches = (visited->memory() > SORTMEMORY);
+
 	uint64_t wr = depth % 2;
-	uint64_t n1 = qIndex1(wrPos);
-	uint64_t n2 = qIndex2(wrPos);
-
-	// Export the old read queue to a file.
-	for (uint64_t i=0; i<n1; i++)
-		file.write((char *)queue[wr][i], BLOCKSIZE * sizeof(Entry));
-	if (n2 > 0)
-		file.write((char *)queue[wr][n1], n2 * sizeof(Entry));
-	file_length += ((uint64_t)BLOCKSIZE) * n1 + n2;
+	uint64_t length = wrPos;
+
+	// The old read queue is still being exported by the writer thread. Wait for it before
+	// its blocks are reused, then start the export of the new read queue. The read queue is
+	// not modified during the expansion of a tree depth, so the writer thread may read it
+	// concurrently with the other threads.
+	waitForWriter();
+	writer = std::thread(&BFSQueue::writeLayer, this, wr, wrFormat, length);
+
+	// The old read queue becomes the new write queue. Since entries are written with
+	// a bitwise OR, the used blocks must be cleared.
+	uint64_t used = (rdLength + rdFormat.perBlock - 1) / rdFormat.perBlock;
+	std::atomic<std::atomic<uint64_t> *> * rdQueue = queue[(depth+1) % 2];
+#pragma omp parallel for
+	for (uint64_t i=0; i<used; i++) {
+		std::atomic<uint64_t> * block = rdQueue[i].load(std::memory_order_relaxed);
+		for (uint64_t j=0; j<BLOCKSIZE; j++)
+			block[j].store(0, std::memory_order_relaxed);
+	}
 	
 	depth++;
-	rdLength = wrPos;
+	rdLength = length;
+	rdFormat = wrFormat;
+	wrFormat = makeFormat(bitsFor(length));
 	wrPos = 0;
 }
 
 /**
- * Checks if the given configuration is already contained in the bit set. If not, the
- * configuration is entered in the bit set and the configuration, the index of the predecessor
+ * Checks if the given configuration is already contained in the visited set. If not, the
+ * configuration is entered in the visited set and the configuration, the index of the predecessor
  * configuration and the number of the moved box are added to the write queue.
  */
 bool BFSQueue::lookup_and_add(uint64_t conf, uint64_t predIndex, uint64_t box)
 {
-	uint64_t bitmask = (uint64_t)1 << bsBitPos(conf);
-	uint64_t i1 = bsIndex1(conf);
-	uint64_t i2 = bsIndex2(conf);
-	
-	// If necessary, allocate an array at the second level and initialize it with 0
-	if (bitset[i1] == NULL)
-		bitset[i1] = new uint64_t[BLOCKSIZE]();
-
-	// If the configuration is in the bit set: we are done
-	if ((bitset[i1][i2] & bitmask) != 0)
+	// If the configuration is in the visited set: we are done
+	if (!visited->testAndSet(conf))
 		return false;
 
-	// add the configuration to the bit set
-	bitset[i1][i2] |= bitmask;
-
 	// Append the configuration, the index of the predecessor configuration and the
-	// number of the moved box at the end of the write queue.
-	
+	// number of the moved box at the end of the write queue. The position in the
+	// write queue is reserved atomically.
+	putEntry(wrPos.fetch_add(1, std::memory_order_relaxed), conf, predIndex, box);
+	return true;
+}
+
+/**
+ * Adds a candidate for the next tree depth to the buffer of thread 'thread', if the
+ * configuration has not been visited at a smaller tree depth. The check is deferred
+ * until a batch of candidates has been collected (at the latest until pushDepth()).
+ * Duplicates within the same tree depth are removed by pushDepth(), i.e., only the
+ * first candidate for a configuration is entered into the queue. Each thread may only
+ * access its own buffer, so the method can be called concurrently by different threads
+ * without synchronization.
+ * If 'forced' is true, the candidate is entered into the queue without these checks and
+ * without entering it into the set of visited configurations (see Config::isTunnelPush()).
+ */
+void BFSQueue::add(int thread, uint64_t conf, uint64_t predIndex, uint64_t box, bool forced)
+{
+	Buffer & buf = buffers[thread];
+	uint64_t * c = &buf.batch[3 * buf.batchLength];
+	c[0] = conf;
+	c[1] = predIndex;
+	c[2] = forced ? box | FORCED : box;
+	if (++buf.batchLength == BATCHSIZE)
+		probeBatch(buf);
+}
+
+// Probe the candidates in the batch of 'buf' against the visited set and append the
+// candidates that have not been visited to the buffer (in the order of the batch).
+void BFSQueue::probeBatch(Buffer & buf)
+{
+	uint64_t n = buf.batchLength;
+	uint64_t keys[BATCHSIZE];
+	bool keep[BATCHSIZE];
+
+	// Sort the candidates by configuration number, so that the visited set is accessed
+	// in ascending order of addresses (for the dense set) instead of at random. The key
+	// contains the configuration number and the index of the candidate in the batch.
+	// If the configuration numbers are too large for a key, the batch is probed unsorted.
+	bool sorted = sortBatches && (configBits + BATCHBITS <= 64);
+	for (uint64_t j=0; j<n; j++)
+		keys[j] = sorted ? (buf.batch[3*j] << BATCHBITS) | j : j;
+	if (sorted)
+		std::sort(keys, keys + n);
+
+	// Probe the visited set. The visited set is not modified while the threads expand the
+	// read queue, so it can be read without synchronization. The memory for the candidate
+	// PREFETCH positions ahead is prefetched, so that several cache misses are handled in
+	// parallel. In sorted order, duplicates within the batch are adjacent, and the first
+	// of them is the earliest one; the others can be dropped right away. Forced candidates
+	// are always kept and do not hide other candidates.
+	uint64_t prev = ~(uint64_t)0;
+	for (uint64_t j=0; j<n; j++) {
+		if (j + PREFETCH < n)
+			visited->prefetch(buf.batch[3 * (keys[j + PREFETCH] & (BATCHSIZE-1))]);
+		uint64_t i = keys[j] & (BATCHSIZE-1);
+		uint64_t conf = buf.batch[3*i];
+		if ((buf.batch[3*i+2] & FORCED) != 0) {
+			keep[i] = true;
+			continue;
+		}
+		keep[i] = (conf != prev) && !visited->contains(conf);
+		prev = conf;
+	}
+
+	// Append the remaining candidates to the buffer
+	for (uint64_t i=0; i<n; i++) {
+		if (!keep[i])
+			continue;
+		uint64_t n1 = buf.length / wrFormat.perBlock;
+		uint64_t bit = (buf.length % wrFormat.perBlock) * wrFormat.width;
+		if (n1 == buf.blocks.size())
+			buf.blocks.push_back(new uint64_t[BLOCKSIZE]);
+		uint64_t * words = buf.blocks[n1];
+		if ((buf.batch[3*i+2] & FORCED) != 0)
+			buf.forced.push_back(buf.length);
+		setBits(words, bit, configBits, buf.batch[3*i]);
+		setBits(words, bit + configBits, boxBits, buf.batch[3*i+2] & ~FORCED);
+		setBits(words, bit + configBits + boxBits, wrFormat.predBits, buf.batch[3*i+1]);
+		buf.length++;
+	}
+	buf.batchLength = 0;
+}
+
+// Return the format of the entries for a predecessor index with 'predBits' bits.
+BFSQueue::Format BFSQueue::makeFormat(uint64_t predBits)
+{
+	Format f;
+	f.predBits = predBits;
+	f.width = configBits + boxBits + predBits;
+	if (f.width == 0)
+		f.width = 1;
+	f.perBlock = BLOCKSIZE * 64 / f.width;
+	return f;
+}
+
+// Store the entry (conf, predIndex, box) at position 'pos' of the write queue.
+// The method is thread-safe.
+void BFSQueue::putEntry(uint64_t pos, uint64_t conf, uint64_t predIndex, uint64_t box)
+{
 	uint64_t wr = depth % 2;
-	uint64_t n1 = qIndex1(wrPos);
-	uint64_t n2 = qIndex2(wrPos);
+	std::atomic<uint64_t> * words = getBlock(queue[wr], pos / wrFormat.perBlock);
+	uint64_t bit = (pos % wrFormat.perBlock) * wrFormat.width;
+	orBits(words, bit, configBits, conf);
+	orBits(words, bit + configBits, boxBits, box);
+	orBits(words, bit + configBits + boxBits, wrFormat.predBits, predIndex);
+}
 
-	// If necessary, allocate an array at the second level and initialize it
-	if (queue[wr][n1] == NULL)
-		queue[wr][n1] = new Entry[BLOCKSIZE]();
+// Merge the per-thread buffers into the write queue (see pushDepth()).
+void BFSQueue::mergeBuffers()
+{
+	const Format & f = wrFormat;
+	uint64_t * offset = new uint64_t[nBuffers+1];
 
-	// Write the new entry at position wrPos into the write queue
-	queue[wr][n1][n2].set(conf, wrPos + (rdLength - predIndex), box);
+	// (0) Probe the remaining candidates of the (incomplete) batches
+#pragma omp parallel for schedule(dynamic)
+	for (int t=0; t<nBuffers; t++)
+		probeBatch(buffers[t]);
 
-	// Increment the write position
-	wrPos++;
-	
-	return true;
+	// (1) Remove the duplicates in parallel. The configurations are divided among 'nBuffers'
+	// owners by their block in the visited set (DenseVisitedSet::bsIndex1()). The candidates
+	// are scattered once into one list per owner, in the order of the buffers (prefix sum
+	// over the number of candidates of each buffer for each owner), and each owner tests its
+	// list in order, so the first candidate for each configuration wins, independent of the
+	// timing of the threads. The visited set is prefetched PREFETCH entries in advance.
+	uint64_t nOwners = nBuffers;
+	std::vector<uint64_t> first(nBuffers+1);	// index of the first entry of buffer t in 'keep'
+	first[0] = 0;
+	for (int t=0; t<nBuffers; t++)
+		first[t+1] = first[t] + buffers[t].length;
+	std::vector<unsigned char> keep(first[nBuffers]);
+	// Forced candidates are kept without a test (see add()); the others are scattered
+	for (int t=0; t<nBuffers; t++) {
+		for (uint64_t j : buffers[t].forced)
+			keep[first[t] + j] = 1;
+		buffers[t].forced.clear();
+	}
+	// count[t*nOwners+o]: number of candidates of buffer t for owner o
+	std::vector<uint64_t> count(nBuffers * nOwners, 0);
+#pragma omp parallel for schedule(dynamic)
+	for (int t=0; t<nBuffers; t++) {
+		Buffer & buf = buffers[t];
+		for (uint64_t j=0; j<buf.length; j++) {
+			if (keep[first[t] + j])
+				continue;
+			uint64_t conf = getBits(buf.blocks[j / f.perBlock], (j % f.perBlock) * f.width,
+									configBits);
+			count[t * nOwners + DenseVisitedSet::bsIndex1(conf) % nOwners]++;
+		}
+	}
+	// Owner o's list starts at ownerStart[o]; buffer t writes its candidates for owner o from
+	// position count[t*nOwners+o] on (after the prefix sum).
+	std::vector<uint64_t> ownerStart(nOwners+1);
+	uint64_t sum = 0;
+	for (uint64_t o=0; o<nOwners; o++) {
+		ownerStart[o] = sum;
+		for (int t=0; t<nBuffers; t++) {
+			uint64_t c = count[t * nOwners + o];
+			count[t * nOwners + o] = sum;
+			sum += c;
+		}
+	}
+	ownerStart[nOwners] = sum;
+	std::vector<uint64_t> candConf(sum);	// configuration of each candidate
+	std::vector<uint64_t> candIndex(sum);	// index of each candidate in 'keep'
+#pragma omp parallel for schedule(dynamic)
+	for (int t=0; t<nBuffers; t++) {
+		Buffer & buf = buffers[t];
+		for (uint64_t j=0; j<buf.length; j++) {
+			if (keep[first[t] + j])
+				continue;
+			uint64_t conf = getBits(buf.blocks[j / f.perBlock], (j % f.perBlock) * f.width,
+									configBits);
+			uint64_t k = count[t * nOwners + DenseVisitedSet::bsIndex1(conf) % nOwners]++;
+			candConf[k] = conf;
+			candIndex[k] = first[t] + j;
+		}
+	}
+#pragma omp parallel for schedule(dynamic)
+	for (uint64_t o=0; o<nOwners; o++) {
+		for (uint64_t k=ownerStart[o]; k<ownerStart[o+1]; k++) {
+			if (k + PREFETCH < ownerStart[o+1])
+				visited->prefetch(candConf[k + PREFETCH]);
+			keep[candIndex[k]] = visited->testAndSet(candConf[k]);
+		}
+	}
+
+	// Compact each buffer in place to the entries that were kept.
+#pragma omp parallel for schedule(dynamic)
+	for (int t=0; t<nBuffers; t++) {
+		Buffer & buf = buffers[t];
+		uint64_t n = 0;
+		for (uint64_t j=0; j<buf.length; j++) {
+			if (!keep[first[t] + j])
+				continue;
+			if (n != j) {
+				uint64_t * words = buf.blocks[j / f.perBlock];
+				uint64_t bit = (j % f.perBlock) * f.width;
+				uint64_t * to = buf.blocks[n / f.perBlock];
+				uint64_t toBit = (n % f.perBlock) * f.width;
+				setBits(to, toBit, configBits, getBits(words, bit, configBits));
+				setBits(to, toBit + configBits, boxBits, getBits(words, bit + configBits, boxBits));
+				setBits(to, toBit + configBits + boxBits, f.predBits,
+						getBits(words, bit + configBits + boxBits, f.predBits));
+			}
+			n++;
+		}
+		buf.length = n;
+	}
+
+	// (2) Prefix sum over the buffer lengths: buffer t is copied to position offset[t] in
+	// the write queue (after the entries added with lookup_and_add()).
+	offset[0] = wrPos;
+	for (int t=0; t<nBuffers; t++)
+		offset[t+1] = offset[t] + buffers[t].length;
+	if (offset[nBuffers] > offset[0]) {
+		for (uint64_t i=offset[0]/f.perBlock; i<=(offset[nBuffers]-1)/f.perBlock; i++)
+			getBlock(queue[depth % 2], i);
+	}
+
+	// (3) Copy the buffers in parallel. Entries at the boundaries of the buffers may share
+	// a word, so putEntry() writes with atomic operations.
+#pragma omp parallel for schedule(dynamic)
+	for (int t=0; t<nBuffers; t++) {
+		Buffer & buf = buffers[t];
+		for (uint64_t j=0; j<buf.length; j++) {
+			uint64_t * words = buf.blocks[j / f.perBlock];
+			uint64_t bit = (j % f.perBlock) * f.width;
+			putEntry(offset[t] + j, getBits(words, bit, configBits),
+					 getBits(words, bit + configBits + boxBits, f.predBits),
+					 getBits(words, bit + configBits, boxBits));
+		}
+		buf.length = 0;
+	}
+
+	wrPos = offset[nBuffers];
+	delete[] offset;
 }
 
 /**
@@ -149,10 +485,12 @@ uint64_t BFSQueue::length()
 uint64_t BFSQueue::get(uint64_t i, uint64_t * box)
 {
 	uint64_t rd = (depth-1) % 2;
-	Entry *e = &queue[rd][qIndex1(i)][qIndex2(i)];
+	std::atomic<uint64_t> * words =
+		queue[rd][i / rdFormat.perBlock].load(std::memory_order_relaxed);
+	uint64_t bit = (i % rdFormat.perBlock) * rdFormat.width;
 	if (box != NULL)
-		*box = e->box;
-	return e->config;
+		*box = getBits(words, bit + configBits, boxBits);
+	return getBits(words, bit, configBits);
 }
 
 /**
@@ -164,46 +502,152 @@ uint64_t BFSQueue::get(uint64_t i, uint64_t * box)
 uint64_t * BFSQueue::getPath(uint64_t conf, uint64_t predIndex,
 								  uint64_t * path_length)
 {
+	waitForWriter();
 	uint64_t * path = new uint64_t[depth+1];
 	path[depth] = conf;
-	uint64_t pos = rdLength - predIndex - 1;
-	int64_t abspos = file_length * sizeof(Entry); // XX
-	
-	// Iterate the path in reversed order
-	for (int64_t k = depth-1; k>=0; k--) {
-		Entry e;
-		// Search the entry for the predecessor configuration in the file and load it
-		file.seekg(-((int)pos+1)*sizeof(Entry), ios::cur);
-		file.read((char *)&e, sizeof(Entry));
-		path[k] = e.config;
-		pos = e.pred;
+	uint64_t pos = predIndex;
+
+	// Map the swap file into memory. Each thread finding a solution uses its own mapping,
+	// so several threads may determine their paths at the same time.
+	void * map = mmap(NULL, file_length, PROT_READ, MAP_SHARED, file, 0);
+	if (map == MAP_FAILED) {
+		cerr << "Cannot map tmp file 'sokoban.tmp'\n";
+		exit(1);
 	}
+	madvise(map, file_length, MADV_RANDOM);
+
+	// Iterate the path in reversed order
+	for (int64_t k = depth-1; k>=0; k--)
+		readEntry((const uint64_t *)map, k, pos, &path[k], &pos);
+	munmap(map, file_length);
 	*path_length = depth+1;
 	return path;
 }
 
+// Compress the first 'length' entries of queue 'q' with format 'f' and append them to the
+// swap file as a new tree depth. Executed by the writer thread: the blocks are compressed
+// in parallel and then written to the file in order.
+void BFSQueue::writeLayer(uint64_t q, Format f, uint64_t length)
+{
+	Layer layer;
+	layer.length = length;
+	layer.format = f;
+	int64_t nBlocks = (length + CBLOCKSIZE - 1) / CBLOCKSIZE;
+	std::vector<std::vector<uint64_t>> compressed(nBlocks);
+#pragma omp parallel for schedule(dynamic) num_threads(nBuffers)
+	for (int64_t b=0; b<nBlocks; b++) {
+		uint64_t first = b * CBLOCKSIZE;
+		uint64_t n = (length-first < CBLOCKSIZE) ? length-first : CBLOCKSIZE;
+		compressBlock(queue[q], f, first, n, compressed[b]);
+	}
+	for (int64_t b=0; b<nBlocks; b++) {
+		layer.blocks.push_back(file_length);
+		const char * data = (const char *)compressed[b].data();
+		uint64_t size = compressed[b].size() * sizeof(uint64_t);
+		while (size > 0) {
+			ssize_t written = pwrite(file, data, size, file_length);
+			if (written < 0) {
+				cerr << "Cannot write tmp file 'sokoban.tmp'\n";
+				exit(1);
+			}
+			data += written;
+			size -= written;
+			file_length += written;
+		}
+		std::vector<uint64_t>().swap(compressed[b]);
+	}
+	layer.blocks.push_back(file_length);
+	layers.push_back(layer);
+}
+
+// Wait until the writer thread has exported the last tree depth.
+void BFSQueue::waitForWriter()
+{
+	std::lock_guard<std::mutex> lock(writerMutex);
+	if (writer.joinable())
+		writer.join();
+}
+
+// Compress the entries first ... first+n-1 of the queue 'q' with format 'f' into 'out'
+// (see bfsqueue.h).
+void BFSQueue::compressBlock(std::atomic<std::atomic<uint64_t> *> * q, const Format & f,
+							 uint64_t first, uint64_t n, std::vector<uint64_t> & out)
+{
+	uint64_t * conf = new uint64_t[n];
+	uint64_t * box = new uint64_t[n];
+	uint64_t * pred = new uint64_t[n];
+	bool sorted = true;
+	for (uint64_t j=0; j<n; j++) {
+		uint64_t pos = first + j;
+		std::atomic<uint64_t> * words = q[pos / f.perBlock].load(std::memory_order_relaxed);
+		uint64_t bit = (pos % f.perBlock) * f.width;
+		conf[j] = getBits(words, bit, configBits);
+		box[j] = getBits(words, bit + configBits, boxBits);
+		pred[j] = getBits(words, bit + configBits + boxBits, f.predBits);
+		if ((j > 0) && (pred[j] < pred[j-1]))
+			sorted = false;
+	}
+
+	BitWriter w(out);
+	w.put(sorted, 1);
+	if (n > 0)
+		w.put(pred[0], f.predBits);
+	for (uint64_t j=0; j<n; j++) {
+		w.put(conf[j], configBits);
+		w.put(box[j], boxBits);
+		if (j > 0) {
+			if (sorted)
+				w.putGamma(pred[j] - pred[j-1] + 1);
+			else
+				w.put(pred[j], f.predBits);
+		}
+	}
+	delete[] conf;
+	delete[] box;
+	delete[] pred;
+}
+
+// Read the entry with index 'i' of the tree depth 'k' from the swap file, which is mapped
+// to address 'map'. Only the compressed block containing the entry is decompressed.
+void BFSQueue::readEntry(const uint64_t * map, uint64_t k, uint64_t i, uint64_t * conf,
+						 uint64_t * predIndex)
+{
+	const Layer & layer = layers[k];
+	uint64_t b = i / CBLOCKSIZE;
+
+	// The blocks consist of whole words, so they are aligned to 8 bytes in the file
+	BitReader r(map + layer.blocks[b] / sizeof(uint64_t));
+	bool sorted = r.get(1);
+	uint64_t pred = r.get(layer.format.predBits);
+	for (uint64_t j=0; j<=i % CBLOCKSIZE; j++) {
+		*conf = r.get(configBits);
+		r.get(boxBits);
+		if (j > 0)
+			pred = sorted ? pred + r.getGamma() - 1 : r.get(layer.format.predBits);
+	}
+	*predIndex = pred;
+}
+
 /**
  * Returns information about RAM and hard disk usage.
  */
 void BFSQueue::statistics()
 {
-	uint64_t size = 2*queue_length*sizeof(Entry *)/1024;
+	waitForWriter();
+	uint64_t size = 2*queue_length*sizeof(uint64_t *)/1024;
 	for (uint64_t i=0; i<queue_length; i++) {
 		if (queue[0][i] != NULL)
-			size += BLOCKSIZE/1024*sizeof(Entry);
+			size += BLOCKSIZE/1024*sizeof(uint64_t);
 		if (queue[1][i] != NULL)
-			size += BLOCKSIZE/1024*sizeof(Entry);
+			size += BLOCKSIZE/1024*sizeof(uint64_t);
 	}
+	for (int t=0; t<nBuffers; t++)
+		size += buffers[t].blocks.size()*BLOCKSIZE/1024*sizeof(uint64_t);
 	cout << "Used " << size << " KBytes for arrays\n";
 	
-	size = bitset_length*sizeof(uint64_t *)/1024;
-	for (uint64_t i=0; i<bitset_length; i++) {
-		if (bitset[i] != NULL)
-			size += BLOCKSIZE/1024*sizeof(uint64_t);
-	}
-	cout << "Used " << size << " KBytes for bit set\n";
+	size = visited->memory()/1024;
+	cout << "Used " << size << " KBytes for visited set (" << visited->name() << ")\n";
 	
-	size = file_length*sizeof(Entry)/1024;
+	size = file_length/1024;
 	cout << "Used " << size << " KBytes for temp file\n";
 }
-
@@ -1,70 +1,189 @@
 #include <iostream>
 #include <cstdint>
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <mutex>
+
+#include "visitedset.h"
 
 /**
  * Data structure for supporting the breadth first search. The data structure primarily implements
- * a queue for configurations, connected with a set (bit set) storing the configurations that have
- * already been visited.
+ * a queue for configurations, connected with a set (see VisitedSet) storing the configurations that
+ * have already been visited.
  */
 class BFSQueue
 {
  private:
 	/*
-	 * Class for an entry in the queue. Each entry contains:
+	 * Each entry in the queue contains:
 	 * - the number of the configuration
-	 * - the relative position of the predecessor configuration in the queue
-	 *   (this is needed to determine the solution path when a solution has been found)
 	 * - the number of the box that was moved to reach this configuration
 	 *   (this is used to preferrably move the same box with the next move)
+	 * - the index of the predecessor configuration in the queue of the previous tree depth
+	 *   (this is needed to determine the solution path when a solution has been found)
+	 * In order to save memory (and space in the swap file), the entries are stored in packed
+	 * form, i.e., as a sequence of bits without padding. The three fields use just as many
+	 * bits as required for the largest possible value: 'configBits' bits for the configuration,
+	 * 'boxBits' bits for the box, and for the predecessor index as many bits as required for
+	 * the length of the previous tree depth ('predBits', which thus changes from depth to depth).
+	 * The class Format describes the layout of the entries for one tree depth.
 	 */
-	class Entry {
+	class Format {
 	public:
-		uint64_t config;
-		uint64_t pred;
-		uint64_t box;
-		
-		inline void set(uint64_t aconfig, uint64_t apred, uint64_t abox) volatile {
-			config = aconfig;
-			pred = apred;
-			box = abox;
-		}
+		uint64_t predBits;     // Number of bits for the predecessor index
+		uint64_t width;        // Number of bits of an entry
+		uint64_t perBlock;     // Number of entries in a block of BLOCKSIZE words
+	};
+
+	/*
+	 * Per-thread buffer for successor configurations. During the expansion of a tree depth,
+	 * each thread appends its candidates (configuration, index of the predecessor in the read
+	 * queue, moved box) to its own buffer, so the threads never write to shared memory.
+	 * pushDepth() merges the buffers into the write queue. The buffer is allocated block by
+	 * block (BLOCKSIZE words each) and uses the same packed format as the write queue; the
+	 * blocks are reused for the next tree depth.
+	 * Before a candidate is appended, it is checked against the visited set. In order to
+	 * avoid a cache miss per candidate, the candidates are first collected in a batch of
+	 * BATCHSIZE candidates, which are probed in the order of their configuration numbers
+	 * (see probeBatch()).
+	 * The class is aligned to a cache line to avoid false sharing of the 'length' counters.
+	 */
+	static const uint64_t BATCHBITS = 10;                 // Batches of 1024 candidates
+	static const uint64_t BATCHSIZE = (1<<BATCHBITS);
+
+	// Number of candidates for which the visited set is prefetched in advance
+	static const uint64_t PREFETCH = 16;
+
+	// Flag for the box of a forced candidate in a batch (see add())
+	static const uint64_t FORCED = (uint64_t)1 << 63;
+
+	// Minimum size of the visited set (in bytes) for sorting the batches
+	static const uint64_t SORTMEMORY = (uint64_t)32 << 20;
+
+	class alignas(64) Buffer {
+	public:
+		std::vector<uint64_t *> blocks;
+		uint64_t length;
+
+		uint64_t batch[3 * BATCHSIZE];   // Configuration, predecessor index, box (| FORCED)
+		uint64_t batchLength;
+
+		std::vector<uint64_t> forced;    // Positions of the forced candidates in the buffer
+
+		Buffer() : length(0), batchLength(0) {}
+	};
+
+	// Probe the candidates in the batch of 'buf' against the visited set and append the
+	// candidates that have not been visited to the buffer (in the order of the batch).
+	void probeBatch(Buffer & buf);
+
+	// Layout of the entries of a tree depth in the swap file. The entries are stored in
+	// compressed blocks of CBLOCKSIZE entries each (see compressBlock()). 'blocks' contains
+	// the position of each block in the file and, as last element, the end of the last block.
+	class Layer {
+	public:
+		uint64_t length;               // Number of entries
+		Format format;                 // Format of the entries
+		std::vector<uint64_t> blocks;  // Positions of the blocks in the file (in bytes)
 	};
 
+	// Number of entries in a compressed block of the swap file
+	static const uint64_t CBLOCKSIZE = 4096;
+
+	// Number of bits for the configuration number and the box number, respectively
+	uint64_t configBits;
+	uint64_t boxBits;
+
 	// Split queue. When processing tree depth X
 	// - the configurations of depth X-1 which are to be examined will be read from queue[(X-1)%2], and
 	// - the successor configurations of depth X will be written into queue[X%2].
-	Entry * volatile * queue[2];
+	// The first-level arrays hold atomic pointers, so that several threads may allocate
+	// second-level blocks concurrently (see lookup_and_add()). The words are atomic, since
+	// entries are packed and thus two threads may write to the same word.
+	std::atomic<std::atomic<uint64_t> *> * queue[2];
 
 	// Number of entries in queue[0] and queue[1], respectively
 	uint64_t queue_length;
 
-	// Position of the next free entry in the write queue
-	volatile uint64_t wrPos;
+	// Format of the entries in the read queue and in the write queue (and buffers)
+	Format rdFormat;
+	Format wrFormat;
+
+	// Position of the next free entry in the write queue. Threads reserve slots in the
+	// write queue by atomically incrementing this counter.
+	std::atomic<uint64_t> wrPos;
 
 	// Length of the read queue
 	uint64_t rdLength;
 
+	// Per-thread buffers with the successor configurations of the current tree depth
+	Buffer * buffers;
+
+	// If 'true', the batches of the buffers are sorted before probing (see probeBatch())
+	bool sortBatches;
+
+	// Number of per-thread buffers (i.e., number of threads)
+	int nBuffers;
+
 	// Current tree depth
 	uint64_t depth;
 
-	// This bit set stores all configurations that already have been examined, in order to
+	// This set stores all configurations that already have been examined, in order to
 	// avoid (1) cycles and (2) multiple examinations of the same configuration.
-	volatile uint64_t * volatile * bitset;
+	VisitedSet * visited;
 
-	// Maximum number of entries in the bit set
-	uint64_t bitset_length;
+	// If 'true', 'visited' is a sparse set which is replaced by a dense set as soon as the
+	// dense set needs less memory (see pushDepth()).
+	bool autoSelect;
 
 	// Swap file. In order to save main memory, only the information for the current tree depth
 	// X and the tree depth X-1 are kept in main memory. The entries of the queues for smaller
 	// tree depths are exported to a temporary file. When we found a solution, they are needed
-	// again to determine the path which lead to the solution.
-	std::fstream         file;
+	// again to determine the path which lead to the solution. The entries are compressed,
+	// see compressBlock(). The file is written with pwrite() at 64-bit offsets and mapped
+	// into memory with mmap() for determining the path (see getPath()).
+	int        file;
 
-	// Number of entries in the swap file
+	// Size of the swap file (in bytes)
 	uint64_t   file_length;
 
+	// Position and format of each tree depth in the swap file
+	std::vector<Layer> layers;
+
+	// Background thread exporting the last completed tree depth to the swap file (see
+	// pushDepth()). While it runs, it owns 'file', 'file_length' and 'layers'; all other
+	// accesses to them must call waitForWriter() first.
+	std::thread writer;
+
+	// Serializes waitForWriter(), which may be called by several threads at the same time
+	std::mutex writerMutex;
+
+	// Compress the first 'length' entries of queue 'q' with format 'f' and append them to the
+	// swap file as a new tree depth. Executed by the writer thread; the blocks are
+	// compressed in parallel and written in order.
+	void writeLayer(uint64_t q, Format f, uint64_t length);
+
+	// Wait until the writer thread has exported the last tree depth.
+	void waitForWriter();
 
-	// The queues and bit sets are dynamically allocated block by block, and only when
+	// Compress the entries first ... first+n-1 of the queue 'q' with format 'f' into 'out'.
+	// Within a tree depth, the predecessor indices are usually sorted, since the threads
+	// append the successors of the read queue in order. A block thus stores the first
+	// predecessor index and then, for each entry, the configuration and the box with their
+	// fixed number of bits and the difference to the previous predecessor index as an Elias
+	// gamma code (i.e., one bit for a difference of 0, three bits for 1 or 2, ...). If the
+	// predecessors of a block are not sorted, they are stored with their fixed number of bits.
+	void compressBlock(std::atomic<std::atomic<uint64_t> *> * q, const Format & f, uint64_t first,
+					   uint64_t n, std::vector<uint64_t> & out);
+
+	// Read the entry with index 'i' of the tree depth 'k' from the swap file, which is mapped
+	// to address 'map'. Only the compressed block containing the entry is decompressed.
+	void readEntry(const uint64_t * map, uint64_t k, uint64_t i, uint64_t * conf,
+				   uint64_t * predIndex);
+
+
+	// The queues are dynamically allocated block by block, and only when
 	// necessary. For this purpose a two-level array (i.e., an array of arrays) is used instead
 	// of a simple array. The second level is only allocated as required (analogous to
 	// two-level page tables in operating systems).
@@ -72,32 +191,89 @@ class BFSQueue
 	// as a[i/2^16][i%2^16], where we first check, if a[i/2^16] != NULL. If not, we will allocate
 	// the second-level array. For computing the first and second index, we use inline functions.
 	// The compiler will copy their code directly to the place where they are used.
-	
+	// For the queues, each second-level array holds 'perBlock' packed entries; an entry never
+	// spans two blocks.
+
 	static const uint64_t BLOCKBITS = 16;                 // 16 Bit, arrays with 65536 int's
 	static const uint64_t BLOCKSIZE = (1<<BLOCKBITS);     // Block size for allocation: 2^16
 	static const uint64_t BLOCKMASK = ((1<<BLOCKBITS)-1); // Bit mask where the last 16 bits
 	                                                          // are set
-	
-	inline uint64_t qIndex1(uint64_t i)  { return i >> BLOCKBITS; }
-	inline uint64_t qIndex2(uint64_t i)  { return i & BLOCKMASK; }
-
-	// The bit set is implemented as a two-level array of 32-bit values. For a given configuration
-	// number, the function bsBitPos returns the bit position within an array element.
-	
-	static const uint64_t WORDBITS = 5;                 // 5 Bit = 0..31, bits in one int
-	static const uint64_t WORDMASK = ((1<<WORDBITS)-1); // Bit mask where the last 5 Bits
-	                                                        // are set
-	
-	inline uint64_t bsIndex1(uint64_t i) { return i >> (WORDBITS + BLOCKBITS); }
-	inline uint64_t bsIndex2(uint64_t i) { return (i >> WORDBITS) & BLOCKMASK; }
-	inline uint64_t bsBitPos(uint64_t i) { return i & WORDMASK; }
+
+	// Return the second-level array a[i1], allocating and installing it if necessary. If
+	// several threads try to install a block at the same time, only one of them succeeds;
+	// the others delete their block and use the installed one.
+	template <class T>
+	static T * getBlock(std::atomic<T *> * a, uint64_t i1)
+	{
+		T * block = a[i1].load(std::memory_order_acquire);
+		if (block == NULL) {
+			T * newBlock = new T[BLOCKSIZE]();
+			if (a[i1].compare_exchange_strong(block, newBlock, std::memory_order_acq_rel))
+				block = newBlock;
+			else
+				delete[] newBlock;
+		}
+		return block;
+	}
+
+	// Return the 'n' bits (n <= 64) starting at bit 'bit' of the word array 'w'.
+	template <class T>
+	static inline uint64_t getBits(const T * w, uint64_t bit, uint64_t n)
+	{
+		if (n == 0)
+			return 0;
+		uint64_t i = bit >> 6;
+		uint64_t off = bit & 63;
+		uint64_t v = (uint64_t)w[i] >> off;
+		if (off + n > 64)
+			v |= (uint64_t)w[i+1] << (64 - off);
+		return (n == 64) ? v : v & (((uint64_t)1 << n) - 1);
+	}
+
+	// Store 'v' in the 'n' bits (n <= 64) starting at bit 'bit' of the word array 'w'.
+	static inline void setBits(uint64_t * w, uint64_t bit, uint64_t n, uint64_t v)
+	{
+		if (n == 0)
+			return;
+		uint64_t i = bit >> 6;
+		uint64_t off = bit & 63;
+		uint64_t mask = (n == 64) ? ~(uint64_t)0 : ((uint64_t)1 << n) - 1;
+		w[i] = (w[i] & ~(mask << off)) | (v << off);
+		if (off + n > 64)
+			w[i+1] = (w[i+1] & ~(mask >> (64 - off))) | (v >> (64 - off));
+	}
+
+	// Atomically OR 'v' into the 'n' bits (n <= 64) starting at bit 'bit' of the word array
+	// 'w'. The bits must be 0 before.
+	static inline void orBits(std::atomic<uint64_t> * w, uint64_t bit, uint64_t n, uint64_t v)
+	{
+		if (n == 0)
+			return;
+		uint64_t i = bit >> 6;
+		uint64_t off = bit & 63;
+		w[i].fetch_or(v << off, std::memory_order_relaxed);
+		if (off + n > 64)
+			w[i+1].fetch_or(v >> (64 - off), std::memory_order_relaxed);
+	}
+
+	// Return the format of the entries for a predecessor index with 'predBits' bits.
+	Format makeFormat(uint64_t predBits);
+
+	// Store the entry (conf, predIndex, box) at position 'pos' of the write queue.
+	// The method is thread-safe.
+	void putEntry(uint64_t pos, uint64_t conf, uint64_t predIndex, uint64_t box);
+
+	// Merge the per-thread buffers into the write queue (see pushDepth()).
+	void mergeBuffers();
 
  public:
 	/**
-	 * Constructor: Create a queue/bit set for configuration numbers between
-	 * 0 and numConf-1.
+	 * Constructor: Create a queue/visited set for configuration numbers between
+	 * 0 and numConf-1 and box numbers between 0 and numBoxes-1, with per-thread buffers
+	 * for 'nThreads' threads. 'kind' selects the implementation of the visited set.
 	 */
-	BFSQueue(uint64_t numConf);
+	BFSQueue(uint64_t numConf, uint64_t numBoxes, int nThreads = 1,
+			 VisitedSet::Kind kind = VisitedSet::AUTO);
 
 	/**
 	 * Destructur: deallocate memory.
@@ -105,24 +281,46 @@ class BFSQueue
 	~BFSQueue();
 
 	/**
-	 * Increase the tree depth by one. The previous write queue becomes the read queue for the
-	 * new tree depth. The old read queue is stored in a temporary file to determine the solution
-	 * path at the end.
+	 * Increase the tree depth by one. The candidates in the per-thread buffers (see add())
+	 * are merged into the write queue, and the previous write queue becomes the read queue
+	 * for the new tree depth. The new read queue is stored in a temporary file to determine
+	 * the solution path at the end. This is done by a background thread while the threads
+	 * expand the new read queue; its memory is reused only after the export has finished,
+	 * i.e., in the next call of pushDepth().
+	 * The buffers are merged in the order of the threads, and the entries of each buffer in
+	 * the order in which they were added. If each thread processes a contiguous range of the
+	 * read queue and these ranges are ordered by thread number (as with OpenMP's static
+	 * schedule), the resulting write queue is identical for any number of threads.
 	 */
 	void pushDepth();
 
 	/**
-	 * Checks if the given configuration is already contained in the bit set. If not, the
-	 * configuration is entered in the bit set and the configuration, the index of the predecessor
+	 * Checks if the given configuration is already contained in the visited set. If not, the
+	 * configuration is entered in the visited set and the configuration, the index of the predecessor
 	 * configuration and the number of the moved box are added to the write queue.
+	 * This method is thread-safe, i.e., it may be called concurrently by several threads
+	 * without further synchronization (but not concurrently with pushDepth()).
 	 */
 	bool lookup_and_add(uint64_t conf, uint64_t predIndex, uint64_t box);
 
+	/**
+	 * Adds a candidate for the next tree depth to the buffer of thread 'thread', if the
+	 * configuration has not been visited at a smaller tree depth. The check is deferred
+	 * until a batch of candidates has been collected (at the latest until pushDepth()).
+	 * Duplicates within the same tree depth are removed by pushDepth(), i.e., only the
+	 * first candidate for a configuration is entered into the queue. Each thread may only
+	 * access its own buffer, so the method can be called concurrently by different threads
+	 * without synchronization.
+	 * If 'forced' is true, the candidate is entered into the queue without these checks and
+	 * without entering it into the set of visited configurations (see Config::isTunnelPush()).
+	 */
+	void add(int thread, uint64_t conf, uint64_t predIndex, uint64_t box, bool forced = false);
+
 	/**
 	 * Return the length of the read queue.
 	 */
 	uint64_t length();
-	
+
 	/**
 	 * Return the i-th entry in the read queue (configuration as return value;
 	 * moved box in *box).
@@ -132,7 +330,7 @@ class BFSQueue
 	/**
 	 * Return the solution path as an array of configurations. The parameter conf is the
 	 * solution configuration, predIndex the index of the predecessor configuration. In *path_length
-	 * the length of the path is returned. The result is allocated dynamically and should be 
+	 * the length of the path is returned. The result is allocated dynamically and should be
 	 * deallocated using delete[].
 	 */
 	uint64_t * getPath(uint64_t conf, uint64_t predIndex, uint64_t * path_length);
@@ -142,4 +340,3 @@ class BFSQueue
 	 */
 	void statistics();
 };
-
@@ -0,0 +1,147 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <cstdint>
+
+/**
+ * Bit set with one bit per cell of the (rectangular) playing field, including the walls.
+ * Cell (x,y) is represented by bit y*width+x, where 'width' is the width of the playing
+ * field. Hence, moving all bits of a set by one cell to the left, up, right, or down
+ * corresponds to shifting the bit set by -1, -width, +1, or +width bits. Since the
+ * playing field is surrounded by walls, bits shifted beyond the end of a row are
+ * removed by masking the result with the set of non-wall cells.
+ * A bit board consists of WORDS 64-bit words, i.e., it can represent playing fields with
+ * up to 64*WORDS cells. All methods are inline, so that the loops over the words are
+ * unrolled by the compiler. WORDS is set at compile time (BITBOARD_WORDS, see makefile):
+ * the fewer words, the faster the bit board operations in the inner loop of the search.
+ * The default of 3 words covers all levels in LEVELS.
+ */
+#ifndef BITBOARD_WORDS
+#define BITBOARD_WORDS 3
+#endif
+
+class Bitboard
+{
+ public:
+	static const unsigned WORDS = BITBOARD_WORDS;
+	static const uint64_t MAXBITS = 64 * WORDS;
+
+	uint64_t w[WORDS];
+
+	/**
+	 * Return an empty bit set.
+	 */
+	static inline Bitboard empty()
+	{
+		Bitboard b;
+		for (unsigned i = 0; i < WORDS; i++)
+			b.w[i] = 0;
+		return b;
+	}
+
+	/**
+	 * Return a bit set containing only bit 'pos'.
+	 */
+	static inline Bitboard single(uint64_t pos)
+	{
+		Bitboard b = empty();
+		b.set(pos);
+		return b;
+	}
+
+	inline void set(uint64_t pos)   { w[pos >> 6] |= (uint64_t)1 << (pos & 63); }
+	inline void clear(uint64_t pos) { w[pos >> 6] &= ~((uint64_t)1 << (pos & 63)); }
+	inline bool test(uint64_t pos) const { return (w[pos >> 6] >> (pos & 63)) & 1; }
+
+	inline bool isEmpty() const
+	{
+		uint64_t x = 0;
+		for (unsigned i = 0; i < WORDS; i++)
+			x |= w[i];
+		return x == 0;
+	}
+
+	/**
+	 * Return the number of the lowest bit that is set. The bit set must not be empty.
+	 */
+	inline uint64_t lowest() const
+	{
+		unsigned i = 0;
+		while (w[i] == 0)
+			i++;
+		return 64 * i + __builtin_ctzll(w[i]);
+	}
+
+	/**
+	 * Return the number of bits that are set.
+	 */
+	inline uint64_t count() const
+	{
+		uint64_t n = 0;
+		for (unsigned i = 0; i < WORDS; i++)
+			n += __builtin_popcountll(w[i]);
+		return n;
+	}
+
+	inline bool operator==(const Bitboard & b) const
+	{
+		uint64_t x = 0;
+		for (unsigned i = 0; i < WORDS; i++)
+			x |= w[i] ^ b.w[i];
+		return x == 0;
+	}
+	inline bool operator!=(const Bitboard & b) const { return !(*this == b); }
+
+	inline Bitboard operator|(const Bitboard & b) const
+	{
+		Bitboard r;
+		for (unsigned i = 0; i < WORDS; i++)
+			r.w[i] = w[i] | b.w[i];
+		return r;
+	}
+
+	inline Bitboard operator&(const Bitboard & b) const
+	{
+		Bitboard r;
+		for (unsigned i = 0; i < WORDS; i++)
+			r.w[i] = w[i] & b.w[i];
+		return r;
+	}
+
+	inline Bitboard operator~() const
+	{
+		Bitboard r;
+		for (unsigned i = 0; i < WORDS; i++)
+			r.w[i] = ~w[i];
+		return r;
+	}
+
+	inline Bitboard & operator|=(const Bitboard & b) { return *this = *this | b; }
+	inline Bitboard & operator&=(const Bitboard & b) { return *this = *this & b; }
+
+	/**
+	 * Shift all bits by 's' positions towards higher bit numbers (0 < s < 64).
+	 */
+	inline Bitboard operator<<(unsigned s) const
+	{
+		Bitboard r;
+		r.w[0] = w[0] << s;
+		for (unsigned i = 1; i < WORDS; i++)
+			r.w[i] = (w[i] << s) | (w[i-1] >> (64 - s));
+		return r;
+	}
+
+	/**
+	 * Shift all bits by 's' positions towards lower bit numbers (0 < s < 64).
+	 */
+	inline Bitboard operator>>(unsigned s) const
+	{
+		Bitboard r;
+		for (unsigned i = 0; i < WORDS - 1; i++)
+			r.w[i] = (w[i] >> s) | (w[i+1] << (64 - s));
+		r.w[WORDS-1] = w[WORDS-1] >> s;
+		return r;
+	}
+};
+
+#endif
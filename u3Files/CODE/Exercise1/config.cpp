@@ -3,6 +3,7 @@
 
 #include "converter.h"
 #include "config.h"
+#include "deadpairtable.h"
 
 uint64_t Config::nBoxConfigs;
 uint64_t Config::solutionConfNo;
@@ -27,7 +28,12 @@ static uint64_t log2(uint64_t num)
 Config* Config::init(const char* fname)
 {
 	Playfield::init(fname);
+	if (Playfield::nBox > MAXBOXES) {
+		std::cerr << "Error: more than " << MAXBOXES << " boxes!" << std::endl;
+		exit(1);
+	}
 	Converter::init(Playfield::nPos, Playfield::nBox);
+	DeadPairTable::init();
 	nBoxConfigs = Converter::getNumConfigs();
 	solutionConfNo = Converter::configToNo(Playfield::goalPos);
 
@@ -47,6 +53,19 @@ bool Config::isSolutionConf(uint64_t conf)
 	return (conf % nBoxConfigs) == solutionConfNo;
 }
 
+/**
+ * Returns the number of the solution configuration where the player is in the connected
+ * component with number 'comp' of the free fields, or 'NONE' if there is no such
+ * component.
+ */
+uint64_t Config::getSolutionConfig(uint64_t comp)
+{
+	if (comp > 3 * Playfield::nBox)
+		return NONE;
+	Config conf(solutionConfNo + comp * nBoxConfigs);
+	return conf.reach.isEmpty() ? NONE : conf.configNo;
+}
+
 /**
  * Returns the maximum amount of configuration numbers. Thus, the configuration numbers
  * all are in the range 0...getNumConfigs()-1.
@@ -64,6 +83,23 @@ uint64_t Config::numBoxes()
 	return Playfield::nBox;
 }
 
+/**
+ * Determine the box positions of 'count' configurations at once (see
+ * Converter::noToConfigs()). The positions of confs[j] are stored in
+ * boxPos[j*numBoxes() ... j*numBoxes()+numBoxes()-1].
+ */
+void Config::boxPositions(const uint64_t confs[], uint64_t count, uint64_t * boxPos)
+{
+	static const uint64_t GROUP = 64;
+	uint64_t nos[GROUP];
+	for (uint64_t j0=0; j0<count; j0+=GROUP) {
+		uint64_t n = (count-j0 < GROUP) ? count-j0 : GROUP;
+		for (uint64_t j=0; j<n; j++)
+			nos[j] = confs[j0+j] % nBoxConfigs;
+		Converter::noToConfigs(nos, n, &boxPos[j0*Playfield::nBox]);
+	}
+}
+
 // ==================================================================
 
 /**
@@ -71,13 +107,11 @@ uint64_t Config::numBoxes()
  */
 Config::Config()
 {
-	boxPos = new uint64_t[Playfield::nBox];
-	comp = new unsigned short[Playfield::nFields];
 	for (uint64_t i = 0; i < Playfield::nBox; i++)
 		boxPos[i] = Playfield::initialBoxPos[i];
 	initBoxesBitSet();
-	setComponents(comp);
-	configNo = Converter::configToNo(boxPos) + comp[Playfield::initialPlayerPos] * nBoxConfigs;
+	boxConfigNo = Converter::configToNo(boxPos);
+	configNo = boxConfigNo + findComponent(Playfield::initialPlayerPos, &reach) * nBoxConfigs;
 }
 
 /**
@@ -85,18 +119,21 @@ Config::Config()
  */
 Config::Config(uint64_t confNo)
 {
-	boxPos = new uint64_t[Playfield::nBox];
-	comp = new unsigned short[Playfield::nFields];
 	setConfig(confNo);
 }
 
 /**
- * Destructur: deallocate memory.
+ * Constructor: creates the configuration with the specified configuration number, whose
+ * box positions 'boxPos' have already been determined (see boxPositions()).
  */
-Config::~Config()
+Config::Config(uint64_t confNo, const uint64_t boxPos[])
 {
-	delete[] comp;
-	delete[] boxPos;
+	boxConfigNo = confNo % nBoxConfigs;
+	for (uint64_t i = 0; i < Playfield::nBox; i++)
+		this->boxPos[i] = boxPos[i];
+	initBoxesBitSet();
+	reach = getComponent(confNo / nBoxConfigs);
+	configNo = confNo;
 }
 
 /**
@@ -112,9 +149,10 @@ uint64_t Config::getConfig()
  */
 void Config::setConfig(uint64_t confNo)
 {
-	Converter::noToConfig(confNo % nBoxConfigs, boxPos);
+	boxConfigNo = confNo % nBoxConfigs;
+	Converter::noToConfig(boxConfigNo, boxPos);
 	initBoxesBitSet();
-	setComponents(comp);
+	reach = getComponent(confNo / nBoxConfigs);
 	configNo = confNo;
 }
 
@@ -135,14 +173,12 @@ uint64_t Config::getNextConfig(uint64_t box, uint64_t dir, uint64_t* newBox)
 	if (isReachable(playerPos)
 		&& Playfield::isValid(newBoxPos) && hasNoBox(newBoxPos)
 		&& !Playfield::isDead(newBoxPos)) {
+		// The configuration number of the new box positions is derived from the current one
+		uint64_t confNo = Converter::moveToNo(boxConfigNo, boxPos, box, newBoxPos);
 		box = moveBox(box, newBoxPos); // Execute the move
-		// Check whether the box is on a target or can be removed again. If not, the move
-		// leads to a dead-end and is not executed.
-		if (Playfield::isGoal(newBoxPos) || canBeEmptied(newBoxPos, 0L)) {
-			uint64_t confNo = Converter::configToNo(boxPos);
-			unsigned short* lcomp = new unsigned short[Playfield::nFields];
-			setComponents(lcomp);
-			uint64_t playerComp = lcomp[pos];
+		// If the move leads to a deadlock, it is not executed.
+		if (!isDeadlock(pos, newBoxPos)) {
+			uint64_t playerComp = findComponent(pos, NULL);
 			result = confNo + playerComp * nBoxConfigs;
 			if (newBox != NULL)
 				*newBox = box;
@@ -153,12 +189,35 @@ uint64_t Config::getNextConfig(uint64_t box, uint64_t dir, uint64_t* newBox)
 }
 
 /**
- * Can the player reach the field 'pos' of the playing field?
+ * Inverse of getNextConfig(): If the current configuration can be reached from a valid
+ * configuration by moving the box 'box' into direction 'dir', the number of this
+ * predecessor configuration is returned, else 'NONE'. I.e., the box is pulled into the
+ * opposite direction, and the player steps back.
+ * *newBox returns the number of the moved box in the predecessor configuration.
  */
-bool Config::isReachable(uint64_t pos)
+uint64_t Config::getPrevConfig(uint64_t box, uint64_t dir, uint64_t* newBox)
 {
-	uint64_t playerComp = configNo / nBoxConfigs;
-	return Playfield::isValid(pos) && (comp[pos] == playerComp);
+	uint64_t pos = boxPos[box];
+	uint64_t oldBoxPos = Playfield::neighbor[dir ^ 2][pos];
+	uint64_t result = NONE;
+
+	// After the push, the player stands on the old position of the box. Before the push,
+	// he stood on the field behind it, which must be free as well.
+	if (isReachable(oldBoxPos) && !Playfield::isDead(oldBoxPos)
+		&& isReachable(Playfield::neighbor[dir ^ 2][oldBoxPos])) {
+		// getNextConfig() only accepts the push if it does not lead to a deadlock
+		if (!isDeadlock(oldBoxPos, pos)) {
+			uint64_t playerPos = Playfield::neighbor[dir ^ 2][oldBoxPos];
+			uint64_t confNo = Converter::moveToNo(boxConfigNo, boxPos, box, oldBoxPos);
+			box = moveBox(box, oldBoxPos); // Execute the pull
+			uint64_t playerComp = findComponent(playerPos, NULL);
+			result = confNo + playerComp * nBoxConfigs;
+			if (newBox != NULL)
+				*newBox = box;
+			moveBox(box, pos); // Undo the pull
+		}
+	}
+	return result;
 }
 
 /**
@@ -173,17 +232,12 @@ void Config::print()
 
 // ==================================================================
 
-// Computes 'boxes' from 'boxPos'.
+// Computes 'boxGrid' from 'boxPos'.
 void Config::initBoxesBitSet()
 {
-	boxes = 0;
-	for (uint64_t p = 0; p < Playfield::nBox; p++) {
-		if (boxPos[p] >= 64) {
-			std::cerr << "Boxes: pos >= 64!" << std::endl;
-			exit(1);
-		}
-		boxes |= ((uint64_t)1 << boxPos[p]);
-	}
+	boxGrid = Bitboard::empty();
+	for (uint64_t p = 0; p < Playfield::nBox; p++)
+		boxGrid.set(Playfield::gridPos[boxPos[p]]);
 }
 
 // Move the 'box'-th box to the field with number 'newPos' and return the new
@@ -192,74 +246,123 @@ void Config::initBoxesBitSet()
 uint64_t Config::moveBox(uint64_t box, uint64_t newPos)
 {
 	uint64_t oldPos = boxPos[box];
-	uint64_t* newBoxPos = new uint64_t[Playfield::nBox];
-	uint64_t j = 0;
-	uint64_t newBox = -1;
-	for (uint64_t i = 0; i < Playfield::nBox; i++) {
-		if (j == box)
-			j++;
-		if ((j < Playfield::nBox) && ((boxPos[j] < newPos) || (newBox != -1))) {
-			newBoxPos[i] = boxPos[j++];
-		}
-		else {
-			newBoxPos[i] = newPos;
-			newBox = i;
-		}
+	// Shift the boxes between the old and the new position by one place, so that the
+	// array stays sorted, and insert the box at the free place.
+	while ((box > 0) && (boxPos[box-1] > newPos)) {
+		boxPos[box] = boxPos[box-1];
+		box--;
 	}
-	for (uint64_t i = 0; i < Playfield::nBox; i++)
-		boxPos[i] = newBoxPos[i];
-	boxes &= ~((uint64_t)1 << oldPos);
-	boxes |= ((uint64_t)1 << newPos);
-	delete[] newBoxPos;
-	return newBox;
+	while ((box+1 < Playfield::nBox) && (boxPos[box+1] < newPos)) {
+		boxPos[box] = boxPos[box+1];
+		box++;
+	}
+	boxPos[box] = newPos;
+	boxGrid.clear(Playfield::gridPos[oldPos]);
+	boxGrid.set(Playfield::gridPos[newPos]);
+	return box;
 }
 
-// Compute the connected components. See attribute 'comp'.
-void Config::setComponents(uint16_t comp[])
+// Return the number of the connected component (see attribute 'reach') that contains
+// the field 'pos'. If 'region' is not NULL, the component is stored in *region.
+uint64_t Config::findComponent(uint64_t pos, Bitboard * region)
 {
-	uint64_t* queue = new uint64_t[Playfield::nFields];
-	uint64_t in = 0;
-	uint64_t out = 0;
-	uint64_t cn = 0;
-	const unsigned short none = -1;
-
-	for (uint64_t i = 0; i < Playfield::nFields; i++)
-		comp[i] = none;
-
-	for (uint64_t i = 0; i < Playfield::nFields; i++) {
-		if ((comp[i] == none) && hasNoBox(i)) {
-			comp[i] = (uint16_t)cn;
-			queue[in++] = i;
-			while (out < in) {
-				uint64_t pos = queue[out++];
-				for (uint64_t dir = 0; dir < 4; dir++) {
-					uint64_t n = Playfield::neighbor[dir][pos];
-					if (Playfield::isValid(n) && (comp[n] == none) && hasNoBox(n)) {
-						comp[n] = (uint16_t)cn;
-						queue[in++] = n;
-					}
-				}
-			}
-			cn++;
+	Bitboard free = Playfield::fieldMask & ~boxGrid;
+	Bitboard remaining = free;
+	uint64_t target = Playfield::gridPos[pos];
+	for (uint64_t cn = 0; ; cn++) {
+		Bitboard c = Playfield::fill(Bitboard::single(remaining.lowest()), remaining);
+		if (c.test(target)) {
+			if (region != NULL)
+				*region = c;
+			return cn;
 		}
+		remaining &= ~c;
 	}
-	delete[] queue;
 }
 
-// Can position 'pos' of the playing field be emptied? The argument 'path' is a
-// bit set to avoid cycles during the search. It is initialized with 0.
-bool Config::canBeEmptied(uint64_t pos, uint64_t path)
+// Return the connected component with number 'n' (an empty set, if there is none).
+Bitboard Config::getComponent(uint64_t n)
 {
-	if (!Playfield::isValid(pos))
-		return false;
-	if (hasNoBox(pos))
-		return true;
-	if ((path & ((uint64_t)1 << pos)) != 0)
+	Bitboard remaining = Playfield::fieldMask & ~boxGrid;
+	for (uint64_t cn = 0; !remaining.isEmpty(); cn++) {
+		Bitboard c = Playfield::fill(Bitboard::single(remaining.lowest()), remaining);
+		if (cn == n)
+			return c;
+		remaining &= ~c;
+	}
+	return remaining;
+}
+
+/**
+ * Tunnel macro: if the last push has moved box 'lastBox' in direction 'dir' onto a field
+ * inside a tunnel (see Playfield::tunnel), and the box can be pushed on in the same
+ * direction, this push does not depend on any other push, and the search only considers
+ * it. Then 'dir' is returned, otherwise 'NONE' (and all pushes are considered). The
+ * direction of the last push is the one whose field behind the box the player can reach:
+ * if the player can reach both sides of the box, 'NONE' is returned.
+ */
+uint64_t Config::getTunnelDir(uint64_t lastBox)
+{
+	uint64_t pos = boxPos[lastBox];
+	for (uint64_t d=0; d<4; d++) {
+		if (((Playfield::tunnel[pos] & ((uint64_t)1 << d)) != 0)
+			&& isReachable(Playfield::neighbor[d ^ 2][pos])
+			&& !isReachable(Playfield::neighbor[d][pos])
+			&& (getNextConfig(lastBox, d, NULL) != NONE))
+			return d;
+	}
+	return NONE;
+}
+
+/**
+ * Is the successor 'next' with the moved box 'newBox', which results from moving box
+ * 'box' in direction 'dir' (see getNextConfig()), restricted by the tunnel macro, i.e.,
+ * does next.getTunnelDir(newBox) return 'dir'? The restriction depends on the push that
+ * led to 'next', so the searches do not enter such successors into their sets of
+ * visited configurations: they must not hide an unrestricted arrival at the same
+ * configuration. 'next' has only one possible predecessor configuration (the one with
+ * the box one field back), so skipping the check costs little.
+ */
+bool Config::isTunnelPush(uint64_t box, uint64_t dir, uint64_t next, uint64_t newBox)
+{
+	// The player stands behind the box after the push, so getTunnelDir() can only return
+	// 'dir', and only if the box has been pushed into a tunnel in this direction
+	uint64_t newPos = Playfield::neighbor[dir][boxPos[box]];
+	if ((Playfield::tunnel[newPos] & ((uint64_t)1 << dir)) == 0)
 		return false;
-	path |= ((uint64_t)1 << pos);
-	return (canBeEmptied(Playfield::neighbor[0][pos], path)
-		&& canBeEmptied(Playfield::neighbor[2][pos], path))
-		|| (canBeEmptied(Playfield::neighbor[1][pos], path)
-			&& canBeEmptied(Playfield::neighbor[3][pos], path));
+	Config c(next);
+	return c.getTunnelDir(newBox) == dir;
 }
 
+// Does the configuration contain a deadlock, i.e., can it never be solved, if the player is
+// on field 'playerPos' and the box on field 'movedPos' has just been moved? This is the case if
+//  - the moved box and another box form a dead pair (see DeadPairTable); the other pairs
+//    have not been changed by the move,
+//  - a box that is not on a target is frozen (see Playfield::frozenBoxes()), or
+//  - there is a region of free fields the player cannot reach (a corral) that contains a
+//    target, and all boxes at its border are frozen. Then the player can never enter the
+//    corral, and no box can be moved onto the target.
+bool Config::isDeadlock(uint64_t playerPos, uint64_t movedPos)
+{
+	for (uint64_t b=0; b<Playfield::nBox; b++) {
+		if ((boxPos[b] != movedPos) && DeadPairTable::isDeadPair(boxPos[b], movedPos))
+			return true;
+	}
+
+	Bitboard frozen = Playfield::frozenBoxes(boxGrid);
+	if (frozen.isEmpty())
+		return false;
+	if (!(frozen & ~Playfield::goalMask).isEmpty())
+		return true;
+
+	Bitboard free = Playfield::fieldMask & ~boxGrid;
+	Bitboard reached = Playfield::fill(Bitboard::single(Playfield::gridPos[playerPos]), free);
+	Bitboard targets = free & ~reached & Playfield::goalMask;
+	while (!targets.isEmpty()) {
+		Bitboard corral = Playfield::fill(Bitboard::single(targets.lowest()), free);
+		if ((Playfield::neighbors(corral) & boxGrid & ~frozen).isEmpty())
+			return true;
+		targets &= ~corral;
+	}
+	return false;
+}
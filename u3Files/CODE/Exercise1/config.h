@@ -19,6 +19,13 @@ class Config
 	 */
 	static const uint64_t NONE = -1L;
 
+	/**
+	 * Maximum number of boxes. The box positions are stored in an array of fixed size within
+	 * the object, so that creating a configuration and computing its successors does not
+	 * require any heap allocation.
+	 */
+	static const uint64_t MAXBOXES = 64;
+
 	/**
 	 * Initialization: The file 'fname' contains a string representation of the Sokoban level,
 	 * i.e., the initial configuration. The return value is the start configuration.
@@ -31,6 +38,13 @@ class Config
 	 */
 	static bool isSolutionConf(uint64_t conf);
 
+	/**
+	 * Returns the number of the solution configuration where the player is in the connected
+	 * component with number 'comp' of the free fields, or 'NONE' if there is no such
+	 * component.
+	 */
+	static uint64_t getSolutionConfig(uint64_t comp);
+
 	/**
 	 * Returns the maximum amount of configuration numbers. Thus, the configuration numbers
 	 * all are in the range 0...getNumConfigs()-1.
@@ -42,6 +56,13 @@ class Config
 	 */
 	static uint64_t numBoxes();
 
+	/**
+	 * Determine the box positions of 'count' configurations at once (see
+	 * Converter::noToConfigs()). The positions of confs[j] are stored in
+	 * boxPos[j*numBoxes() ... j*numBoxes()+numBoxes()-1].
+	 */
+	static void boxPositions(const uint64_t confs[], uint64_t count, uint64_t * boxPos);
+
 	/**
 	 * Default constructor: initial configuration
 	 */
@@ -53,9 +74,10 @@ class Config
 	Config(uint64_t confNo);
 
 	/**
-	 * Destructur: deallocate memory.
+	 * Constructor: creates the configuration with the specified configuration number, whose
+	 * box positions 'boxPos' have already been determined (see boxPositions()).
 	 */
-	~Config();
+	Config(uint64_t confNo, const uint64_t boxPos[]);
 
 	/**
 	 * Returns the configuration number for this configuration.
@@ -76,6 +98,36 @@ class Config
 	 */
 	uint64_t getNextConfig(uint64_t box, uint64_t dir, uint64_t * newBox);
 
+	/**
+	 * Inverse of getNextConfig(): If the current configuration can be reached from a valid
+	 * configuration by moving the box 'box' into direction 'dir', the number of this
+	 * predecessor configuration is returned, else 'NONE'. I.e., the box is pulled into the
+	 * opposite direction, and the player steps back.
+	 * *newBox returns the number of the moved box in the predecessor configuration.
+	 */
+	uint64_t getPrevConfig(uint64_t box, uint64_t dir, uint64_t * newBox);
+
+	/**
+	 * Tunnel macro: if the last push has moved box 'lastBox' in direction 'dir' onto a field
+	 * inside a tunnel (see Playfield::tunnel), and the box can be pushed on in the same
+	 * direction, this push does not depend on any other push, and the search only considers
+	 * it. Then 'dir' is returned, otherwise 'NONE' (and all pushes are considered). The
+	 * direction of the last push is the one whose field behind the box the player can reach:
+	 * if the player can reach both sides of the box, 'NONE' is returned.
+	 */
+	uint64_t getTunnelDir(uint64_t lastBox);
+
+	/**
+	 * Is the successor 'next' with the moved box 'newBox', which results from moving box
+	 * 'box' in direction 'dir' (see getNextConfig()), restricted by the tunnel macro, i.e.,
+	 * does next.getTunnelDir(newBox) return 'dir'? The restriction depends on the push that
+	 * led to 'next', so the searches do not enter such successors into their sets of
+	 * visited configurations: they must not hide an unrestricted arrival at the same
+	 * configuration. 'next' has only one possible predecessor configuration (the one with
+	 * the box one field back), so skipping the check costs little.
+	 */
+	bool isTunnelPush(uint64_t box, uint64_t dir, uint64_t next, uint64_t newBox);
+
 	/**
 	 * Is there a box on field 'pos' of the playfield?
 	 * For reasons of efficiency, this method is declared as 'inline,
@@ -83,13 +135,17 @@ class Config
 	 */
 	inline bool hasBox(uint64_t pos)
 	{
-		return Playfield::isValid(pos) && ((boxes & ((uint64_t)1 << pos)) != 0);
+		return Playfield::isValid(pos) && boxGrid.test(Playfield::gridPos[pos]);
 	}
 
 	/**
 	 * Can the player reach the field 'pos' of the playing field?
+	 * For reasons of efficiency, this method is declared as 'inline'.
 	 */
-	bool isReachable(uint64_t pos);
+	inline bool isReachable(uint64_t pos)
+	{
+		return Playfield::isValid(pos) && reach.test(Playfield::gridPos[pos]);
+	}
 
 	/**
 	 * Print the configuration 'graphically'.
@@ -107,30 +163,33 @@ class Config
 	// Configuration number of this configuration
 	uint64_t configNo;
 
+	// Configuration number of the box positions (i.e., configNo % nBoxConfigs)
+	uint64_t boxConfigNo;
+
 	// Array storing the positions of the boxes on the playing field. This array is always
 	// sorted according to the positions!
-	uint64_t * boxPos;
+	uint64_t boxPos[MAXBOXES];
 
-	// Bit set with the positions of the boxes. I.e., if bit 'i' is set, there is a box on
-	// field 'i' of the playing field.
-	uint64_t boxes;
+	// The positions of the boxes as a bit board (see class Bitboard). The bit board has one
+	// bit per cell, so the number of fields is only limited by Bitboard::MAXBITS.
+	Bitboard boxGrid;
 
-	// For for each position of the playing field, this array contains the connected component
-	// associated with that position. The player can only move within its current connected
-	// component. For each possible position of the player, this array therefore indicates
-	// which other fields the player can reach.
-	unsigned short * comp;
+	// Bit board with the fields the player can reach, i.e., the connected component of the
+	// fields without boxes that contains the player. The connected components are numbered
+	// in the order of their lowest bit in the bit board; the number of the player's
+	// component is part of the configuration number.
+	Bitboard reach;
 
 
-	// Computes 'boxes' from 'boxPos'.
+	// Computes 'boxGrid' from 'boxPos'.
 	void initBoxesBitSet();
 	
-	// Checks whether the field with number 'pos' has no box on it.
+	// Checks whether the (valid) field with number 'pos' has no box on it.
 	// For efficiency reasons, this method is declared inline, i.e., a call to this method is
 	// replaced by a copy of the method's body.
 	inline bool hasNoBox(uint64_t pos)
 	{
-		return (pos >= 64) || ((boxes & ((uint64_t)1 << pos)) == 0);
+		return !boxGrid.test(Playfield::gridPos[pos]);
 	}
 
 	// Move the 'box'-th box to the field with number 'newPos' and return the new
@@ -138,11 +197,18 @@ class Config
 	// position on the playing field).
 	uint64_t moveBox(uint64_t box, uint64_t newPos);
 
-	// Compute the connected components. See attribute 'comp'.
-	void setComponents(unsigned short comp[]);
+	// Return the number of the connected component (see attribute 'reach') that contains
+	// the field 'pos'. If 'region' is not NULL, the component is stored in *region.
+	uint64_t findComponent(uint64_t pos, Bitboard * region);
+
+	// Return the connected component with number 'n' (an empty set, if there is none).
+	Bitboard getComponent(uint64_t n);
 
-	// Can position 'pos' of the playing field be emptied? The argument 'path' is a
-	// bit set to avoid cycles during the search. It is initialized with 0.
-	bool canBeEmptied(uint64_t pos, uint64_t path);
+	// Does the configuration contain a deadlock, i.e., can it never be solved, if the player
+	// is on field 'playerPos' and the box on field 'movedPos' has just been moved? Dead pairs
+	// of boxes that contain the moved box are looked up in the DeadPairTable; frozen boxes that
+	// are not on a target and corrals with a target that are enclosed by frozen boxes are
+	// detected on the bit boards.
+	bool isDeadlock(uint64_t playerPos, uint64_t movedPos);
 };
 
@@ -5,82 +5,10 @@
 
 uint64_t  Converter::maxN;             // Number of fields
 uint64_t  Converter::maxK;             // Number of boxes
-uint64_t ** Converter::cacheNoverK;   // cacheNoverK[n][k] contains (n+1) over (k+1)
-uint64_t *** Converter::cacheConfNo;  // cacheConfNo[n][k][s] contains the number
-                                           // of the first configuration where the first
-                                           // box is on field 's'.
-
-// Initialize the array cacheNoverK.
-void Converter::initNoverK()
-{
-	// (n k) = n*(n-1)*...*(n-k+1) / k*(k-1)*...*1
-	// (n k) = (n-1 k) * n / (n-k)
-	// (n k) = (n k-1) * (n-k+1) / k
-	for (uint64_t n=1; n<=maxN; n++) {
-		cacheNoverK[n-1][0] = n;
-		for (uint64_t k=2; k<=maxK; k++) {
-			cacheNoverK[n-1][k-1] = cacheNoverK[n-1][k-2] * (n-k+1) / k;
-		}
-	}
-}
-
-// Returns the value of the binomial coefficient 'n over k' (n k).
-uint64_t Converter::nOverK(uint64_t n, uint64_t k)
-{
-	return k == 0 ? 1 : cacheNoverK[n-1][k-1];
-}
-
-// Initialize the array cacheConfNo.
-void Converter::initConfNo()
-{
-	for (uint64_t n=1; n<maxN; n++) {
-		for (uint64_t k=0; k<=n && k<maxK; k++) {
-			cacheConfNo[n][k][0] = 0;
-			for (uint64_t i=1; i<=n-k; i++) {
-				cacheConfNo[n][k][i] = cacheConfNo[n][k][i-1] + nOverK(n-i+1,k);
-			}
-		}
-	}
-}
-
-// Return the number of the first configuration where the first
-// box is on field 's'.
-uint64_t Converter::confNo(uint64_t n, uint64_t k, uint64_t s)
-{
-	return cacheConfNo[n-1][k-1][s];
-}
-
-// Find the largest entry <= 'no' in the array 'ary[lo:hi-1]' and return its index.
-uint64_t Converter::find(uint64_t ary[], uint64_t lo, uint64_t hi,
-							 uint64_t no)
-{
-	while (lo < hi) {
-		uint64_t m = (lo+hi+1)/2;
-		if (ary[m] == no)
-			return m;
-		if (ary[m] < no) {
-			lo = m;
-		}
-		else {
-			hi = m-1;
-		}
-	}
-	return lo;
-}
-
-// In a situation with 'n' remaining fields and 'k' remaining boxes for a configuration
-// number 'no', search the position 's' of the first remaining box and the number of the
-// first configuration, where this box is on field 's'.
-uint64_t Converter::findPos(uint64_t n, uint64_t k, uint64_t no, uint64_t* val)
-{
-	uint64_t * ary = cacheConfNo[n-1][k-1];
-	uint64_t pos = find(ary, 0, n-k, no);
-	*val = ary[pos];
-	return pos;
-}
+uint64_t * Converter::binom;           // binom[k*(maxN+1)+m] contains m over k (k <= maxK)
 
 // =========================================================
-	
+
 /** Initialize the class. Arguments:
  *   n = number of fields
  *   k = number of boxes
@@ -89,19 +17,14 @@ void Converter::init(uint64_t n, uint64_t k)
 {
 	maxN = n;
 	maxK = k;
-	
-	cacheNoverK = new uint64_t*[n];
-	for (uint64_t i=0; i<n; i++)
-		cacheNoverK[i] = new uint64_t[k]();
-	initNoverK();
-	
-	cacheConfNo = new uint64_t**[n];
-	for (uint64_t i=0; i<n; i++) {
-		cacheConfNo[i] = new uint64_t*[k];
-		for (uint64_t j=0; j<k; j++)
-			cacheConfNo[i][j] = new uint64_t[n]();
+
+	// (m k) = (m-1 k-1) + (m-1 k)
+	binom = new uint64_t[(k+1)*(n+1)]();
+	for (uint64_t m=0; m<=n; m++) {
+		binom[m] = 1;
+		for (uint64_t j=1; j<=k && j<=m; j++)
+			binom[j*(n+1) + m] = binom[(j-1)*(n+1) + m-1] + binom[j*(n+1) + m-1];
 	}
-	initConfNo();
 }
 
 /** Return the number of possible box configurations. */
@@ -113,24 +36,81 @@ uint64_t Converter::getNumConfigs()
 /** Determine the configuration number from the box positions in 'boxpos'. */
 uint64_t Converter::configToNo(uint64_t boxpos[])
 {
-	uint64_t no = 0;
-	uint64_t startpos = 0;
-	for (uint64_t i=0; i<maxK; i++) {
-		no += confNo(maxN-startpos, maxK-i, boxpos[i]-startpos);
-		startpos = boxpos[i] + 1;
-	}
-	return no;
+	uint64_t sum = 0;
+	for (uint64_t i=0; i<maxK; i++)
+		sum += term(boxpos[i], i);
+	return nOverK(maxN, maxK) - 1 - sum;
 }
 
 /** Determine the box positions corresponding to the specified configuration number. */
 void Converter::noToConfig(uint64_t no, uint64_t * boxpos)
 {
-	uint64_t startpos = 0;
+	// rest = sum_i C(c_i, k-i) with c_i = maxN-1-boxpos[i] strictly decreasing. For each box,
+	// c_i is the largest c with C(c, k-i) <= rest. Since c_i < c_{i-1}, the search continues
+	// downwards where it stopped for the previous box, i.e., all boxes together need at most
+	// maxN steps through the table.
+	uint64_t rest = nOverK(maxN, maxK) - 1 - no;
+	uint64_t c = maxN;
 	for (uint64_t i=0; i<maxK; i++) {
-		uint64_t val;
-		uint64_t pos = findPos(maxN-startpos, maxK-i, no, &val);
-		boxpos[i] = startpos + pos;
-		no -= val;
-		startpos = boxpos[i] + 1;
+		const uint64_t * row = &binom[(maxK-i)*(maxN+1)];
+		do {
+			c--;
+		} while (row[c] > rest);
+		rest -= row[c];
+		boxpos[i] = maxN-1-c;
+	}
+}
+
+/**
+ * Determine the box positions for 'count' configuration numbers at once. The positions
+ * for nos[j] are stored in boxpos[j*k ... j*k+k-1]. The numbers are decoded box by box
+ * in an interleaved fashion, so that the processor can overlap the independent decodes.
+ */
+void Converter::noToConfigs(const uint64_t nos[], uint64_t count, uint64_t * boxpos)
+{
+	// Same as noToConfig(), but c_i is determined by a branch-free binary search over the
+	// whole table row. The number of steps thus is the same for all numbers of a group, and
+	// the searches of the group are independent of each other.
+	static const uint64_t GROUP = 8;
+	uint64_t rest[GROUP];
+	for (uint64_t j0=0; j0<count; j0+=GROUP) {
+		uint64_t n = (count-j0 < GROUP) ? count-j0 : GROUP;
+		for (uint64_t j=0; j<n; j++)
+			rest[j] = nOverK(maxN, maxK) - 1 - nos[j0+j];
+		for (uint64_t i=0; i<maxK; i++) {
+			const uint64_t * row = &binom[(maxK-i)*(maxN+1)];
+			for (uint64_t j=0; j<n; j++) {
+				uint64_t c = 0;
+				for (uint64_t len = maxN; len > 1; len -= len/2)
+					c = (row[c + len/2] <= rest[j]) ? c + len/2 : c;
+				rest[j] -= row[c];
+				boxpos[(j0+j)*maxK + i] = maxN-1-c;
+			}
+		}
+	}
+}
+
+/**
+ * Incremental update: 'no' is the number of the configuration 'boxpos'. Returns the
+ * number of the configuration where box 'box' has been moved to field 'newPos'. Only the
+ * terms of the boxes between the old and the new position are recomputed. 'boxpos'
+ * itself is not modified.
+ */
+uint64_t Converter::moveToNo(uint64_t no, const uint64_t boxpos[], uint64_t box,
+							 uint64_t newPos)
+{
+	// The number is C(n,k)-1 minus the sum of the terms; all computations are modulo 2^64.
+	no += term(boxpos[box], box);
+	uint64_t i = box;
+	if (newPos > boxpos[box]) {
+		// The boxes between the old and the new position move down by one index
+		for (; (i+1 < maxK) && (boxpos[i+1] < newPos); i++)
+			no += term(boxpos[i+1], i+1) - term(boxpos[i+1], i);
+	}
+	else {
+		// The boxes between the new and the old position move up by one index
+		for (; (i > 0) && (boxpos[i-1] > newPos); i--)
+			no += term(boxpos[i-1], i-1) - term(boxpos[i-1], i);
 	}
+	return no - term(newPos, i);
 }
@@ -4,6 +4,11 @@
  * This class (with only static attributes and methods) converts a configuration of boxes,
  * i.e., an array containing the positions of the boxes, into an integer (the configuration
  * number), and vice versa.
+ * The configurations are numbered in lexicographic order of the (sorted) box positions.
+ * For n fields and k boxes at the positions p[0] < p[1] < ... < p[k-1], the number is
+ *    C(n,k) - 1 - sum_{i=0..k-1} C(n-1-p[i], k-i)
+ * where C(n,k) is the binomial coefficient 'n over k'. The binomial coefficients are
+ * stored in a single contiguous table, one row per k.
  */
 class Converter
 {
@@ -13,44 +18,45 @@ class Converter
 	 *   k = number of boxes
 	 */
 	static void init(uint64_t n, uint64_t k);
-	
+
 	/** Return the number of possible box configurations. */
 	static uint64_t getNumConfigs();
-	
+
 	/** Determine the configuration number from the box positions in 'boxpos'. */
 	static uint64_t configToNo(uint64_t boxpos[]);
-	
+
 	/** Determine the box positions corresponding to the specified configuration number. */
 	static void noToConfig(uint64_t no, uint64_t * bospos);
-	
+
+	/**
+	 * Determine the box positions for 'count' configuration numbers at once. The positions
+	 * for nos[j] are stored in boxpos[j*k ... j*k+k-1]. The numbers are decoded box by box
+	 * in an interleaved fashion, so that the processor can overlap the independent decodes.
+	 */
+	static void noToConfigs(const uint64_t nos[], uint64_t count, uint64_t * boxpos);
+
+	/**
+	 * Incremental update: 'no' is the number of the configuration 'boxpos'. Returns the
+	 * number of the configuration where box 'box' has been moved to field 'newPos'. Only the
+	 * terms of the boxes between the old and the new position are recomputed. 'boxpos'
+	 * itself is not modified.
+	 */
+	static uint64_t moveToNo(uint64_t no, const uint64_t boxpos[], uint64_t box, uint64_t newPos);
+
  private:
 	static uint64_t maxN;              // Number of fields
 	static uint64_t maxK;              // Number of boxes
-	static uint64_t ** cacheNoverK;   // cacheNoverK[n][k] contains (n+1) over (k+1)
-	static uint64_t *** cacheConfNo;  // cacheConfNo[n][k][s] contains the number
-	                                       // of the first configuration where the first
-                                           // box is on field 's'.
-	
-	// Initialize the array cacheNoverK.
-	static void initNoverK();
-	
-	// Returns the value of the binomial coefficient 'n over k' (n k).
-	static uint64_t nOverK(uint64_t n, uint64_t k);
-	
-	// Initialize the array cacheConfNo.
-	static void initConfNo();
-	
-	// Return the number of the first configuration where the first
-	// box is on field 's'.
-	static uint64_t confNo(uint64_t n, uint64_t k, uint64_t s);
-	
-	// Find the largest entry <= 'no' in the array 'ary[lo:hi-1]' and return its index.
-	static uint64_t find(uint64_t ary[], uint64_t lo, uint64_t hi,
-							 uint64_t no);
-	
-	// In a situation with 'n' remaining fields and 'k' remaining boxes for a configuration
-	// number 'no', search the position 's' of the first remaining box and the number of the
-	// first configuration, where this box is on field 's'.
-	static uint64_t findPos(uint64_t n, uint64_t k, uint64_t no,
-								uint64_t* val);
+	static uint64_t * binom;           // binom[k*(maxN+1)+m] contains m over k (k <= maxK)
+
+	// Returns the value of the binomial coefficient 'm over k' (m k).
+	static inline uint64_t nOverK(uint64_t m, uint64_t k)
+	{
+		return binom[k*(maxN+1) + m];
+	}
+
+	// Term of the box with index 'i' on field 'pos' in the sum of the configuration number.
+	static inline uint64_t term(uint64_t pos, uint64_t i)
+	{
+		return nOverK(maxN-1-pos, maxK-i);
+	}
 };
@@ -0,0 +1,95 @@
+#include <vector>
+#include <unordered_set>
+
+#include "config.h"
+#include "deadpairtable.h"
+
+/**
+ * Table of the dead pairs of boxes of the playing field, computed before the search.
+ */
+
+uint64_t DeadPairTable::nPos;
+bool * DeadPairTable::dead;
+
+
+/**
+ * Initialize the table for the current playing field (see Playfield::init()), i.e.,
+ * classify all pairs of fields (in parallel).
+ */
+void DeadPairTable::init()
+{
+	nPos = Playfield::nPos;
+	dead = new bool[nPos * nPos]();
+#pragma omp parallel for schedule(dynamic)
+	for (uint64_t a=0; a<nPos; a++) {
+		for (uint64_t b=a+1; b<nPos; b++)
+			dead[a * nPos + b] = classify(a, b);
+	}
+}
+
+// State of the reduced problem: the (sorted) fields of the two boxes and the connected
+// component of the free fields that contains the player
+class PairState {
+public:
+	uint64_t pos[2];
+	Bitboard reach;
+
+	// Key for the set of visited states: the component is identified by its lowest bit
+	uint64_t key() const
+	{
+		return (pos[0] * Playfield::nPos + pos[1]) * Bitboard::MAXBITS + reach.lowest();
+	}
+};
+
+// Is the pair of boxes on the fields 'a' < 'b' dead?
+bool DeadPairTable::classify(uint64_t a, uint64_t b)
+{
+	// Breadth first search from all components of the player. Pushes onto dead-end fields
+	// are not considered (see Playfield), since a box there can never reach a target.
+	std::vector<PairState> layer;
+	std::unordered_set<uint64_t> visited;
+	Bitboard boxes = Bitboard::single(Playfield::gridPos[a]);
+	boxes.set(Playfield::gridPos[b]);
+	Bitboard remaining = Playfield::fieldMask & ~boxes;
+	while (!remaining.isEmpty()) {
+		PairState s;
+		s.pos[0] = a;
+		s.pos[1] = b;
+		s.reach = Playfield::fill(Bitboard::single(remaining.lowest()), remaining);
+		remaining &= ~s.reach;
+		visited.insert(s.key());
+		layer.push_back(s);
+	}
+
+	bool result = true;
+	while (!layer.empty() && result) {
+		std::vector<PairState> next;
+		for (const PairState & s : layer) {
+			if (Playfield::isGoal(s.pos[0]) && Playfield::isGoal(s.pos[1])) {
+				result = false;
+				break;
+			}
+			for (uint64_t k=0; k<2; k++) {
+				for (uint64_t dir=0; dir<4; dir++) {
+					uint64_t playerPos = Playfield::neighbor[dir ^ 2][s.pos[k]];
+					uint64_t newPos = Playfield::neighbor[dir][s.pos[k]];
+					if (!Playfield::isValid(playerPos) || !s.reach.test(Playfield::gridPos[playerPos])
+						|| !Playfield::isValid(newPos) || Playfield::isDead(newPos)
+						|| (newPos == s.pos[1-k]))
+						continue;
+					PairState t;
+					t.pos[0] = (newPos < s.pos[1-k]) ? newPos : s.pos[1-k];
+					t.pos[1] = (newPos < s.pos[1-k]) ? s.pos[1-k] : newPos;
+					Bitboard grid = Bitboard::single(Playfield::gridPos[t.pos[0]]);
+					grid.set(Playfield::gridPos[t.pos[1]]);
+					t.reach = Playfield::fill(Bitboard::single(Playfield::gridPos[s.pos[k]]),
+											  Playfield::fieldMask & ~grid);
+					if (visited.insert(t.key()).second)
+						next.push_back(t);
+				}
+			}
+		}
+		layer.swap(next);
+	}
+	return result;
+}
@@ -0,0 +1,36 @@
+#include <cstdint>
+
+/**
+ * This class (with only static attributes and methods) is a table of the dead pairs of boxes
+ * of the playing field: pairs of fields such that boxes on both fields can never be moved
+ * onto targets together, whatever the other boxes and the player do. The table is computed
+ * statically in init(), before the search starts: each pair is classified by a breadth first
+ * search in the problem reduced to the two boxes (no other boxes, the player in any connected
+ * component). If no state with both boxes on targets can be reached, the pair is dead; since
+ * the other boxes can only restrict the moves, every configuration that contains the pair is
+ * a deadlock as well (see Config::isDeadlock()). The table is read-only during the search.
+ */
+class DeadPairTable
+{
+ public:
+	/**
+	 * Initialize the table for the current playing field (see Playfield::init()), i.e.,
+	 * classify all pairs of fields (in parallel).
+	 */
+	static void init();
+
+	/**
+	 * Is the pair of boxes on the (different) fields 'a' and 'b' dead?
+	 */
+	static inline bool isDeadPair(uint64_t a, uint64_t b)
+	{
+		return dead[(a < b) ? a * nPos + b : b * nPos + a];
+	}
+
+ private:
+	static uint64_t nPos;          // Number of fields that may contain a box
+	static bool * dead;            // dead[a*nPos+b]: is the pair a < b dead?
+
+	// Is the pair of boxes on the fields 'a' < 'b' dead?
+	static bool classify(uint64_t a, uint64_t b);
+};
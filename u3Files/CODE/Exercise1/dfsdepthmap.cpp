@@ -1,3 +1,6 @@
+#include <stdlib.h>
+#include <string.h>
+
 #include <string>
 #include <iostream>
 
@@ -8,25 +11,108 @@
  * For depth first search, this class performs a mapping from a configuration number to the
  * lowest depth found so far for the corresponding configuration (i.e., the minimum number of
  * moves from the initial configuration to the given configuration, which has been found until
- * now).
+ * now). There are two implementations (backends), DenseDFSDepthMap and SparseDFSDepthMap.
  */
 
 
 /**
- * Constructor: Creates a new mapping for configuration numbers between
- * 0 and numConf-1 and a maximum depth of 'maxDepth'.
+ * Create a new mapping for configuration numbers between 0 and numConf-1 and a maximum
+ * depth of 'maxDepth', which is used by up to 'nThreads' threads, using the backend
+ * 'kind'. The depth first search has no point where all threads are idle and the
+ * mapping could be converted, so AUTO selects the dense backend.
+ */
+DFSDepthMap * DFSDepthMap::create(VisitedSet::Kind kind, uint64_t numConf, uint64_t maxDepth,
+								  int nThreads)
+{
+	if (kind == VisitedSet::SPARSE)
+		return new SparseDFSDepthMap(numConf, maxDepth, nThreads);
+	return new DenseDFSDepthMap(numConf, maxDepth, nThreads);
+}
+
+/**
+ * Constructor: Creates the counters for a maximum depth of 'maxDepth' and up to
+ * 'nThreads' threads.
  */
-DFSDepthMap::DFSDepthMap(uint64_t numConf, uint64_t maxDepth)
+DFSDepthMap::DFSDepthMap(uint64_t maxDepth, int nThreads)
 {
-	depth_length = index1(numConf-1) + 1;
-	depth = new volatile unsigned char*[depth_length]();
-	nConfigs = new volatile uint64_t[maxDepth+1]();
+	// The depths 1 ... maxDepth must fit into 8 bits (0 means 'not yet found')
+	if (maxDepth >= 256) {
+		std::cerr << "Maximum depth " << maxDepth << " is too large (at most 255)" << std::endl;
+		exit(1);
+	}
+	max_depth = maxDepth;
+	this->nThreads = nThreads;
+	linesPerThread = maxDepth / 8 + 1;
+	nConfigs = new CacheLine[nThreads * linesPerThread]();
 }
 
 /**
  *  Destructur: deallocate memory.
  */
 DFSDepthMap::~DFSDepthMap()
+{
+	delete[] nConfigs;
+}
+
+/**
+ * Return the number of configurations in the mapping.
+ */
+uint64_t DFSDepthMap::size()
+{
+	int64_t n = 0;
+	for (uint64_t i=1; i<=max_depth; i++) {
+		for (int t=0; t<nThreads; t++)
+			n += counter(t, i);
+	}
+	return n;
+}
+
+/**
+ * Returns information about RAM and hard disk usage and the number of
+ * examined configurations for all depths < 'maxDepth'.
+ */
+void DFSDepthMap::statistics(uint64_t maxDepth)
+{
+	for (uint64_t i=1; i<maxDepth; i++) {
+		int64_t n = 0;
+		for (int t=0; t<nThreads; t++)
+			n += counter(t, i);
+		std::cerr << "depth " << i << ": " << n << std::endl;
+	}
+
+	std::cout << "Used " << memory()/1024 << " KBytes for depth map (" << name() << ")"
+			  << std::endl;
+}
+
+// =========================================================
+
+/**
+ * Constructor: Creates a new mapping for configuration numbers between
+ * 0 and numConf-1 and a maximum depth of 'maxDepth', which is used by up to
+ * 'nThreads' threads.
+ */
+DenseDFSDepthMap::DenseDFSDepthMap(uint64_t numConf, uint64_t maxDepth, int nThreads)
+	: DFSDepthMap(maxDepth, nThreads)
+{
+	// Use the smallest entry size that can store all depths 1 ... maxDepth
+	// (0 means 'not yet found')
+	if (maxDepth < 16)
+		bits = 4;
+	else if (maxDepth < 64)
+		bits = 6;
+	else
+		bits = 8;
+	perWord = 64 / bits;
+	mask = ((uint64_t)1 << bits) - 1;
+
+	depth_length = index1((numConf-1) / perWord) + 1;
+	depth = new std::atomic<std::atomic<uint64_t> *>[depth_length]();
+}
+
+/**
+ *  Destructur: deallocate memory.
+ */
+DenseDFSDepthMap::~DenseDFSDepthMap()
 {
 	for (uint64_t i=0; i<depth_length; i++) {
 		delete[] depth[i];
@@ -37,45 +123,160 @@ DFSDepthMap::~DFSDepthMap()
 /**
  * Checks whether there is an entry for 'conf' with a depth <= 'newDepth'.
  * If so, return 'false', else set the depth of 'conf' in the mapping to
- * 'newDepth' and return 'true'.
+ * 'newDepth' and return 'true'. 'thread' is the number of the calling thread.
+ * The method is thread-safe and lock-free.
  */
-bool DFSDepthMap::lookup_and_set(uint64_t conf, uint64_t newDepth)
+bool DenseDFSDepthMap::lookup_and_set(int thread, uint64_t conf, uint64_t newDepth)
 {
-	uint64_t i1 = index1(conf);
-	uint64_t i2 = index2(conf);
-
-	// If necessary, allocate an array at the second level and initialize it with 0
-	if (depth[i1] == NULL)
-		depth[i1] = new unsigned char[BLOCKSIZE]();
-	
-	// If there is an entry with equal or smaller depth: we are done
-	unsigned char old = depth[i1][i2];
-	if ((old != 0) && (old <= (unsigned char)newDepth))
-		return false;
-
-	// Enter the depth and update the number of configurations for this depth
-	depth[i1][i2] = (unsigned char)newDepth;
-	if (old != 0)
-		nConfigs[old]--;
-	nConfigs[newDepth]++;
-		
+	uint64_t w = conf / perWord;
+	uint64_t shift = (conf % perWord) * bits;
+	uint64_t i1 = index1(w);
+	uint64_t i2 = index2(w);
+
+	// If necessary, allocate an array at the second level and initialize it with 0. If
+	// several threads try to install a block at the same time, only one of them succeeds;
+	// the others delete their block and use the installed one.
+	std::atomic<uint64_t> * block = depth[i1].load(std::memory_order_acquire);
+	if (block == NULL) {
+		std::atomic<uint64_t> * newBlock = new std::atomic<uint64_t>[BLOCKSIZE]();
+		if (depth[i1].compare_exchange_strong(block, newBlock, std::memory_order_acq_rel))
+			block = newBlock;
+		else
+			delete[] newBlock;
+	}
+
+	// If there is an entry with equal or smaller depth: we are done. Otherwise enter the
+	// new depth. If another thread has modified the word in the meantime, the check is
+	// repeated with the new contents of the word.
+	uint64_t word = block[i2].load(std::memory_order_relaxed);
+	uint64_t old;
+	do {
+		old = (word >> shift) & mask;
+		if ((old != 0) && (old <= newDepth))
+			return false;
+	} while (!block[i2].compare_exchange_weak(word, (word & ~(mask << shift)) | (newDepth << shift),
+											   std::memory_order_relaxed));
+
+	// Update the number of configurations for this depth
+	count(thread, old, newDepth);
+
 	return true;
 }
 
 /**
- * Returns information about RAM and hard disk usage and the number of
- * examined configurations for all depths < 'maxDepth'.
+ * Return the number of bytes of main memory used by the mapping.
  */
-void DFSDepthMap::statistics(uint64_t maxDepth)
+uint64_t DenseDFSDepthMap::memory()
 {
-	for (uint64_t i=1; i<maxDepth; i++)
-		std::cerr << "depth " << i << ": " << nConfigs[i] << std::endl;
-			 
-	uint64_t size = depth_length/1024*sizeof(uint64_t);
+	uint64_t size = depth_length*sizeof(uint64_t);
 	for (uint64_t i=0; i<depth_length; i++) {
 		if (depth[i] != NULL)
-			size += BLOCKSIZE/1024;
+			size += BLOCKSIZE*sizeof(uint64_t);
+	}
+	return size;
+}
+
+// =========================================================
+
+/**
+ * Constructor: Creates an empty mapping for configuration numbers between
+ * 0 and numConf-1 and a maximum depth of 'maxDepth', which is used by up to
+ * 'nThreads' threads.
+ */
+SparseDFSDepthMap::SparseDFSDepthMap(uint64_t numConf, uint64_t maxDepth, int nThreads)
+	: DFSDepthMap(maxDepth, nThreads)
+{
+	if (numConf > (EMPTY >> DEPTHBITS)) {
+		std::cerr << "Too many configurations for a sparse depth map" << std::endl;
+		exit(1);
+	}
+	shards = new Shard[SHARDS];
+	for (uint64_t s=0; s<SHARDS; s++) {
+		shards[s].bits = __builtin_ctzll(INITIAL_CAPACITY);
+		shards[s].slots = new uint64_t[INITIAL_CAPACITY];
+		memset(shards[s].slots, 0xff, INITIAL_CAPACITY * sizeof(uint64_t));
+		shards[s].count = 0;
+	}
+}
+
+/**
+ *  Destructur: deallocate memory.
+ */
+SparseDFSDepthMap::~SparseDFSDepthMap()
+{
+	for (uint64_t s=0; s<SHARDS; s++)
+		delete[] shards[s].slots;
+	delete[] shards;
+}
+
+// Insert the entry 'e' into the slots of 'shard' (no check for duplicates, no locking)
+void SparseDFSDepthMap::insert(Shard & shard, uint64_t e)
+{
+	uint64_t mask = ((uint64_t)1 << shard.bits) - 1;
+	uint64_t i = slotOf(hash(e >> DEPTHBITS), shard.bits);
+	while (shard.slots[i] != EMPTY)
+		i = (i + 1) & mask;
+	shard.slots[i] = e;
+	shard.count++;
+}
+
+/**
+ * Checks whether there is an entry for 'conf' with a depth <= 'newDepth'.
+ * If so, return 'false', else set the depth of 'conf' in the mapping to
+ * 'newDepth' and return 'true'. 'thread' is the number of the calling thread.
+ * The method is thread-safe.
+ */
+bool SparseDFSDepthMap::lookup_and_set(int thread, uint64_t conf, uint64_t newDepth)
+{
+	uint64_t h = hash(conf);
+	Shard & shard = shards[shardOf(h)];
+	uint64_t old = 0;
+	{
+		std::lock_guard<std::mutex> lock(shard.lock);
+
+		uint64_t mask = ((uint64_t)1 << shard.bits) - 1;
+		uint64_t i = slotOf(h, shard.bits);
+		for (; shard.slots[i] != EMPTY; i = (i + 1) & mask) {
+			if ((shard.slots[i] >> DEPTHBITS) == conf) {
+				old = shard.slots[i] & DEPTHMASK;
+				break;
+			}
+		}
+		if ((old != 0) && (old <= newDepth))
+			return false;
+		if (old == 0)
+			shard.count++;
+		shard.slots[i] = (conf << DEPTHBITS) | newDepth;
+
+		// If the shard is half full: double its size and rehash the entries
+		if (2 * shard.count > mask + 1) {
+			uint64_t * oldSlots = shard.slots;
+			uint64_t oldCapacity = mask + 1;
+			shard.bits++;
+			shard.slots = new uint64_t[2 * oldCapacity];
+			memset(shard.slots, 0xff, 2 * oldCapacity * sizeof(uint64_t));
+			shard.count = 0;
+			for (uint64_t j=0; j<oldCapacity; j++) {
+				if (oldSlots[j] != EMPTY)
+					insert(shard, oldSlots[j]);
+			}
+			delete[] oldSlots;
+		}
 	}
-	std::cout << "Used " << size << " KBytes for arrays" << std::endl;
+
+	// Update the number of configurations for this depth
+	count(thread, old, newDepth);
+
+	return true;
 }
 
+/**
+ * Return the number of bytes of main memory used by the mapping.
+ */
+uint64_t SparseDFSDepthMap::memory()
+{
+	uint64_t size = SHARDS*sizeof(Shard);
+	for (uint64_t s=0; s<SHARDS; s++)
+		size += ((uint64_t)1 << shards[s].bits) * sizeof(uint64_t);
+	return size;
+}
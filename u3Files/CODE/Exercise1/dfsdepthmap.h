@@ -1,61 +1,220 @@
 #include <cstdint>
+#include <atomic>
+#include <mutex>
+
+#include "visitedset.h"
 
 /**
  * For depth first search, this class performs a mapping from a configuration number to the
  * lowest depth found so far for the corresponding configuration (i.e., the minimum number of
  * moves from the initial configuration to the given configuration, which has been found until
- * now).
+ * now). Like VisitedSet, there are two implementations (backends):
+ * - DenseDFSDepthMap: a packed array with one entry per configuration number.
+ * - SparseDFSDepthMap: a hash table of the configurations found so far.
  */
 class DFSDepthMap
+{
+ protected:
+	// Maximum depth
+	uint64_t max_depth;
+
+	// For correctness checking: number of configurations at each tree depth. Each thread
+	// counts in its own array (which may contain negative values, if a thread reduces the
+	// depth of a configuration that has been counted by another thread); statistics() adds
+	// them up. The arrays are stored as cache lines: each thread's array starts at a cache
+	// line and is padded to whole lines, so that no two threads write to the same line.
+	class alignas(64) CacheLine {
+	public:
+		int64_t n[8];
+	};
+	CacheLine * nConfigs;
+
+	// Number of cache lines per thread in 'nConfigs'
+	uint64_t linesPerThread;
+
+	// Counter of thread 't' for depth 'd'
+	int64_t & counter(int t, uint64_t d) { return nConfigs[t * linesPerThread + d / 8].n[d % 8]; }
+
+	// Number of threads (i.e., number of counter arrays)
+	int nThreads;
+
+	// Count a configuration whose depth changed from 'old' (0 if it was not in the
+	// mapping) to 'newDepth' by thread 'thread'.
+	void count(int thread, uint64_t old, uint64_t newDepth)
+	{
+		if (old != 0)
+			counter(thread, old)--;
+		counter(thread, newDepth)++;
+	}
+
+	/**
+	 * Constructor: Creates the counters for a maximum depth of 'maxDepth' and up to
+	 * 'nThreads' threads.
+	 */
+	DFSDepthMap(uint64_t maxDepth, int nThreads);
+
+ public:
+	/**
+	 * Create a new mapping for configuration numbers between 0 and numConf-1 and a maximum
+	 * depth of 'maxDepth', which is used by up to 'nThreads' threads, using the backend
+	 * 'kind'. The depth first search has no point where all threads are idle and the
+	 * mapping could be converted, so AUTO selects the dense backend.
+	 */
+	static DFSDepthMap * create(VisitedSet::Kind kind, uint64_t numConf, uint64_t maxDepth,
+								int nThreads = 1);
+
+	/**
+	 *  Destructur: deallocate memory.
+	 */
+	virtual ~DFSDepthMap();
+
+	/**
+	 * Checks whether there is an entry for 'conf' with a depth <= 'newDepth'.
+	 * If so, return 'false', else set the depth of 'conf' in the mapping to
+	 * 'newDepth' and return 'true'. 'thread' is the number of the calling thread.
+	 * The method is thread-safe.
+	 */
+	virtual bool lookup_and_set(int thread, uint64_t conf, uint64_t newDepth) = 0;
+
+	/**
+	 * Return the number of bytes of main memory used by the mapping.
+	 */
+	virtual uint64_t memory() = 0;
+
+	/**
+	 * Return the name of the backend.
+	 */
+	virtual const char * name() = 0;
+
+	/**
+	 * Return the number of configurations in the mapping.
+	 */
+	uint64_t size();
+
+	/**
+	 * Returns information about RAM and hard disk usage and the number of
+	 * examined configurations for all depths < 'maxDepth'.
+	 */
+	void statistics(uint64_t maxDepth);
+};
+
+/**
+ * Packed array with one entry per configuration number.
+ */
+class DenseDFSDepthMap : public DFSDepthMap
 {
  private:
 	// The map is implemented as a two-level array (i.e., an array of arrays), where the second
 	// level is only allocated as required (analogous to two-level page tables in operating
 	// systems).
-	// The arrays of the second level have 2^16 entries each. An access to a[i] thus is realized
-	// as a[i/2^16][i%2^16], where we first check, if a[i/2^16] != NULL. If not, we will allocate
-	// the second-level array. For computing the first and second index, we use inline functions.
-	// The compiler will copy their code directly to the place where they are used.
-	
-	static const uint64_t BLOCKBITS = 16;                 // 16 Bit, arrays with 65536 int's
-	static const uint64_t BLOCKSIZE = (1<<BLOCKBITS);     // Block size for allocation: 2^16
-	static const uint64_t BLOCKMASK = ((1<<BLOCKBITS)-1); // Bit mask where the last 16 bits
+	// The arrays of the second level have 2^13 64-bit words each. An access to a[i] thus is
+	// realized as a[i/2^13][i%2^13], where we first check, if a[i/2^13] != NULL. If not, we
+	// will allocate the second-level array. For computing the first and second index, we use
+	// inline functions. The compiler will copy their code directly to the place where they are
+	// used.
+	// The depths are packed into the words with 'bits' bits per entry (4, 6, or 8, depending
+	// on the maximum depth), i.e., word i contains the entries i*perWord ... i*perWord+perWord-1.
+	// An entry never spans two words. Since several threads may update different entries of
+	// the same word, the words are updated with compare-and-swap.
+
+	static const uint64_t BLOCKBITS = 13;                 // 13 Bit, arrays with 8192 words
+	static const uint64_t BLOCKSIZE = (1<<BLOCKBITS);     // Block size for allocation: 2^13
+	static const uint64_t BLOCKMASK = ((1<<BLOCKBITS)-1); // Bit mask where the last 13 bits
 	                                                          // are set
-	
+
 	inline uint64_t index1(uint64_t i)  { return i >> BLOCKBITS; }
 	inline uint64_t index2(uint64_t i)  { return i & BLOCKMASK; }
 
-	// Mapping from configuration number to tree depth, using a two-level array
-	volatile unsigned char * volatile * depth;
-	
+	// Number of bits per entry, number of entries per word and mask for an entry
+	uint64_t bits;
+	uint64_t perWord;
+	uint64_t mask;
+
+	// Mapping from configuration number to tree depth, using a two-level array of packed words.
+	// The first-level array holds atomic pointers, so that several threads may allocate
+	// second-level blocks concurrently.
+	std::atomic<std::atomic<uint64_t> *> * depth;
+
 	// Number of entries in 'depth'
 	uint64_t depth_length;
 
-	// For correctness checking: number of configurations at each tree depth
-	volatile uint64_t * nConfigs;
-
  public:
 	/**
 	 * Constructor: Creates a new mapping for configuration numbers between
-	 * 0 and numConf-1 and a maximum depth of 'maxDepth'.
+	 * 0 and numConf-1 and a maximum depth of 'maxDepth', which is used by up to
+	 * 'nThreads' threads.
 	 */
-	DFSDepthMap(uint64_t numConf, uint64_t maxDepth);
-	
+	DenseDFSDepthMap(uint64_t numConf, uint64_t maxDepth, int nThreads = 1);
+
 	/**
 	 *  Destructur: deallocate memory.
 	 */
-	~DFSDepthMap();
+	~DenseDFSDepthMap();
 
 	/**
-	 * Checks whether there is an entry for 'conf' with a depth <= 'newDepth'.
-	 * If so, return 'false', else set the depth of 'conf' in the mapping to
-	 * 'newDepth' and return 'true'.
+	 * The method is lock-free (see DFSDepthMap::lookup_and_set()).
+	 */
+	bool lookup_and_set(int thread, uint64_t conf, uint64_t newDepth);
+	uint64_t memory();
+	const char * name() { return "dense"; }
+};
+
+/**
+ * Hash table of the configurations found so far and their depths. Like SparseVisitedSet,
+ * the table is split into SHARDS open addressing hash tables with linear probing, each
+ * protected by its own lock and doubled in size when it is half full. A slot holds the
+ * configuration number in the upper 56 bits and its depth in the lower 8 bits.
+ */
+class SparseDFSDepthMap : public DFSDepthMap
+{
+ private:
+	static const uint64_t SHARDBITS = 8;
+	static const uint64_t SHARDS = (1<<SHARDBITS);
+
+	// Number of bits for the depth in a slot
+	static const uint64_t DEPTHBITS = 8;
+	static const uint64_t DEPTHMASK = ((1<<DEPTHBITS)-1);
+
+	// Marks an empty slot (not a valid entry)
+	static const uint64_t EMPTY = ~(uint64_t)0;
+
+	// Initial number of slots of a shard (power of 2)
+	static const uint64_t INITIAL_CAPACITY = 64;
+
+	// One shard of the hash table. The class is aligned to a cache line to avoid false sharing.
+	class alignas(64) Shard {
+	public:
+		std::mutex lock;
+		uint64_t * slots;       // Entries (conf << DEPTHBITS | depth) or EMPTY
+		uint64_t bits;          // Number of slots is 2^bits
+		uint64_t count;         // Number of used slots
+	};
+
+	Shard * shards;
+
+	// Hash value of a configuration number (Fibonacci hashing). The upper SHARDBITS bits
+	// select the shard, the following bits the first slot to probe within the shard.
+	static inline uint64_t hash(uint64_t conf) { return conf * 0x9E3779B97F4A7C15ULL; }
+	static inline uint64_t shardOf(uint64_t h) { return h >> (64 - SHARDBITS); }
+	static inline uint64_t slotOf(uint64_t h, uint64_t bits) { return (h << SHARDBITS) >> (64 - bits); }
+
+	// Insert the entry 'e' into the slots of 'shard' (no check for duplicates, no locking)
+	static void insert(Shard & shard, uint64_t e);
+
+ public:
+	/**
+	 * Constructor: Creates an empty mapping for configuration numbers between
+	 * 0 and numConf-1 and a maximum depth of 'maxDepth', which is used by up to
+	 * 'nThreads' threads.
 	 */
-	bool lookup_and_set(uint64_t conf, uint64_t newDepth);
+	SparseDFSDepthMap(uint64_t numConf, uint64_t maxDepth, int nThreads = 1);
 
 	/**
-	 * Returns information about RAM and hard disk usage and the number of
-	 * examined configurations for all depths < 'maxDepth'.
+	 *  Destructur: deallocate memory.
 	 */
-	void statistics(uint64_t maxDepth);
+	~SparseDFSDepthMap();
+
+	bool lookup_and_set(int thread, uint64_t conf, uint64_t newDepth);
+	uint64_t memory();
+	const char * name() { return "sparse"; }
 };
@@ -0,0 +1,205 @@
+#include <stdlib.h>
+
+#include <iostream>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <omp.h>
+
+#include "config.h"
+#include "distancedb.h"
+
+using namespace std;
+
+/**
+ * Database with the exact distance (number of pushes) to a solution for each configuration
+ * of a level, computed by a retrograde breadth first search and stored in a memory-mapped
+ * file.
+ */
+
+
+/**
+ * Compute the database for the current level (see Config::init()) and store it in the
+ * file 'fname'.
+ */
+void DistanceDB::build(const char * fname)
+{
+	uint64_t numConfigs = Config::getNumConfigs();
+	uint64_t length = HEADERSIZE + numConfigs;
+
+	// Create the file with its final size. Pages that are never written (configurations
+	// that cannot reach a solution) do not occupy any disk space.
+	int fd = open(fname, O_RDWR|O_CREAT|O_TRUNC, 0644);
+	if ((fd < 0) || (ftruncate(fd, length) != 0)) {
+		cerr << "Cannot create database file '" << fname << "'\n";
+		exit(1);
+	}
+	void * m = mmap(NULL, length, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	if (m == MAP_FAILED) {
+		cerr << "Cannot map database file '" << fname << "'\n";
+		exit(1);
+	}
+	unsigned char * dist = (unsigned char *)m + HEADERSIZE;
+
+	// The solution configurations have the distance 0: all boxes are on a target, the player
+	// may be in any connected component of the free fields.
+	vector<uint64_t> layer;
+	for (uint64_t comp=0; ; comp++) {
+		uint64_t conf = Config::getSolutionConfig(comp);
+		if (conf == Config::NONE)
+			break;
+		dist[conf] = 1;
+		layer.push_back(conf);
+	}
+
+	// Retrograde breadth first search: the predecessors of the configurations with distance
+	// 'depth' that have no distance yet get the distance 'depth+1'. The predecessors are
+	// collected by each thread in its own vector; the distances are only written afterwards,
+	// so the threads only read the map during the expansion.
+	int nThreads = omp_get_max_threads();
+	vector<vector<uint64_t>> next(nThreads);
+	uint64_t nBoxes = Config::numBoxes();
+	uint64_t depth = 0;
+	uint64_t total = 0;
+	while (!layer.empty()) {
+		cerr << "distance " << depth << ": " << layer.size() << endl << flush;
+		total += layer.size();
+		if (depth + 1 > MAXDISTANCE) {
+			cerr << "Error: distance larger than " << MAXDISTANCE << "!" << endl;
+			exit(1);
+		}
+
+#pragma omp parallel for schedule(dynamic, 1024)
+		for (uint64_t i=0; i<layer.size(); i++) {
+			vector<uint64_t> & prev = next[omp_get_thread_num()];
+			Config conf(layer[i]);
+			for (uint64_t box=0; box<nBoxes; box++) {
+				for (uint64_t dir=0; dir<4; dir++) {
+					uint64_t c = conf.getPrevConfig(box, dir, NULL);
+					if ((c != Config::NONE) && (dist[c] == 0))
+						prev.push_back(c);
+				}
+			}
+		}
+
+		depth++;
+		layer.clear();
+		for (int t=0; t<nThreads; t++) {
+			for (uint64_t c : next[t]) {
+				if (dist[c] == 0) {
+					dist[c] = depth + 1;
+					layer.push_back(c);
+				}
+			}
+			next[t].clear();
+		}
+	}
+
+	Header * header = (Header *)m;
+	header->magic = MAGIC;
+	header->numConfigs = numConfigs;
+	header->fingerprint = Playfield::fingerprint();
+	header->maxDistance = depth - 1;
+	cerr << "Solvable configurations: " << total << ", maximum distance: " << (depth - 1)
+		 << endl;
+
+	if (msync(m, length, MS_SYNC) != 0) {
+		cerr << "Cannot write database file '" << fname << "'\n";
+		exit(1);
+	}
+	munmap(m, length);
+	close(fd);
+}
+
+/**
+ * Constructor: Map the database in file 'fname' into memory. The database must have been
+ * built for the playing field of the current level.
+ */
+DistanceDB::DistanceDB(const char * fname)
+{
+	struct stat st;
+	file = open(fname, O_RDONLY);
+	if ((file < 0) || (fstat(file, &st) != 0)) {
+		cerr << "Cannot open database file '" << fname << "'\n";
+		exit(1);
+	}
+	file_length = st.st_size;
+	void * m = MAP_FAILED;
+	if (file_length >= HEADERSIZE)
+		m = mmap(NULL, file_length, PROT_READ, MAP_SHARED, file, 0);
+	if (m == MAP_FAILED) {
+		cerr << "Cannot map database file '" << fname << "'\n";
+		exit(1);
+	}
+	map = (unsigned char *)m;
+
+	Header * header = (Header *)map;
+	if ((header->magic != MAGIC) || (header->numConfigs != Config::getNumConfigs())
+		|| (header->fingerprint != Playfield::fingerprint())
+		|| (file_length != HEADERSIZE + header->numConfigs)) {
+		cerr << "Error: database file '" << fname << "' does not belong to this level!\n";
+		exit(1);
+	}
+	// The solution path only touches few configurations
+	madvise(map, file_length, MADV_RANDOM);
+}
+
+/**
+ * Destructur: unmap and close the file.
+ */
+DistanceDB::~DistanceDB()
+{
+	munmap(map, file_length);
+	close(file);
+}
+
+/**
+ * Return the number of pushes needed to solve configuration 'conf', or Config::NONE if
+ * there is no solution.
+ */
+uint64_t DistanceDB::distance(uint64_t conf)
+{
+	uint64_t d = map[HEADERSIZE + conf];
+	return (d == 0) ? Config::NONE : d - 1;
+}
+
+/**
+ * Return the solution path for configuration 'conf' as an array of configurations.
+ * In *path_length the length of the path is returned. If there is no solution, the
+ * result is NULL and *path_length is 0. The result is allocated dynamically and should
+ * be deallocated using delete[].
+ */
+uint64_t * DistanceDB::getPath(uint64_t conf, uint64_t * path_length)
+{
+	uint64_t d = distance(conf);
+	if (d == Config::NONE) {
+		*path_length = 0;
+		return NULL;
+	}
+
+	// Each configuration with distance k > 0 has a successor with distance k-1. The
+	// smallest one is chosen.
+	uint64_t nBoxes = Config::numBoxes();
+	uint64_t * path = new uint64_t[d+1];
+	path[0] = conf;
+	for (uint64_t k=1; k<=d; k++) {
+		Config c(path[k-1]);
+		path[k] = Config::NONE;
+		for (uint64_t box=0; box<nBoxes; box++) {
+			for (uint64_t dir=0; dir<4; dir++) {
+				uint64_t s = c.getNextConfig(box, dir, NULL);
+				if ((s != Config::NONE) && (s < path[k]) && (distance(s) == d-k))
+					path[k] = s;
+			}
+		}
+		if (path[k] == Config::NONE) {
+			cerr << "FATAL ERROR: Inconsistent database!" << endl;
+			exit(1);
+		}
+	}
+	*path_length = d+1;
+	return path;
+}
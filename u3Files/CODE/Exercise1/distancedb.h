@@ -0,0 +1,70 @@
+#include <cstdint>
+
+/**
+ * Database with the exact distance (number of pushes) to a solution for each configuration
+ * of a level. The database is computed once by a retrograde breadth first search, i.e., a
+ * breadth first search from all solution configurations that uses pulls instead of pushes
+ * (see Config::getPrevConfig()), and stored in a file with one byte per configuration
+ * number. The file is mapped into memory when it is used, so any starting configuration of
+ * the level is solved by following decreasing distances, without a search.
+ * The configuration numbers only depend on the playing field and the number of boxes, so the
+ * database can be used for all levels with the same playing field, targets and dead-end
+ * fields, regardless of the initial positions of the boxes and the player.
+ */
+class DistanceDB
+{
+ private:
+	// Header at the beginning of the file. The distances start at offset HEADERSIZE, so that
+	// the header occupies one page.
+	class Header {
+	public:
+		uint64_t magic;
+		uint64_t numConfigs;   // Number of configurations
+		uint64_t fingerprint;  // See Playfield::fingerprint()
+		uint64_t maxDistance;  // Largest distance in the database
+	};
+
+	static const uint64_t MAGIC = 0x31424452424f4b53ULL; // "SKOBRDB1"
+	static const uint64_t HEADERSIZE = 4096;
+
+	// Distances stored in a byte: 0 if the configuration cannot reach a solution,
+	// otherwise 1 + distance.
+	static const uint64_t MAXDISTANCE = 254;
+
+	// Memory-mapped file and its length (in bytes)
+	int file;
+	uint64_t file_length;
+	unsigned char * map;
+
+ public:
+	/**
+	 * Compute the database for the current level (see Config::init()) and store it in the
+	 * file 'fname'.
+	 */
+	static void build(const char * fname);
+
+	/**
+	 * Constructor: Map the database in file 'fname' into memory. The database must have been
+	 * built for the playing field of the current level.
+	 */
+	DistanceDB(const char * fname);
+
+	/**
+	 * Destructur: unmap and close the file.
+	 */
+	~DistanceDB();
+
+	/**
+	 * Return the number of pushes needed to solve configuration 'conf', or Config::NONE if
+	 * there is no solution.
+	 */
+	uint64_t distance(uint64_t conf);
+
+	/**
+	 * Return the solution path for configuration 'conf' as an array of configurations.
+	 * In *path_length the length of the path is returned. If there is no solution, the
+	 * result is NULL and *path_length is 0. The result is allocated dynamically and should
+	 * be deallocated using delete[].
+	 */
+	uint64_t * getPath(uint64_t conf, uint64_t * path_length);
+};
@@ -0,0 +1,295 @@
+#include <stdlib.h>
+#include <sys/types.h>
+
+#include <iostream>
+#include <algorithm>
+#include <queue>
+
+#include "externalqueue.h"
+
+using namespace std;
+
+/**
+ * Data structure for an external-memory breadth first search with delayed duplicate detection.
+ * The layers and the set of visited configurations are kept in temporary files, sorted by
+ * configuration number.
+ */
+
+
+/**
+ * Constructor: Create a queue that uses at most 'memory' bytes for the run buffers of
+ * 'nThreads' threads.
+ */
+ExternalQueue::ExternalQueue(uint64_t memory, int nThreads)
+{
+	nBuffers = nThreads;
+	buffers = new Buffer[nBuffers];
+	runLength = memory / sizeof(Entry) / nBuffers;
+	if (runLength < BUFSIZE)
+		runLength = BUFSIZE;
+	visited = createFile();
+	nVisited = 0;
+	file_length = 0;
+	max_file_length = 0;
+}
+
+/**
+ * Destructur: close (and thus delete) the temporary files and deallocate memory.
+ */
+ExternalQueue::~ExternalQueue()
+{
+	for (FILE * f : layers)
+		fclose(f);
+	for (FILE * f : runs)
+		fclose(f);
+	fclose(visited);
+	delete[] buffers;
+}
+
+// Create a new temporary file. The file is deleted when it is closed. The file name is
+// unique, since several threads may create files at the same time.
+FILE * ExternalQueue::createFile()
+{
+	char name[] = "sokoban.ext.XXXXXX";
+	int fd = mkstemp(name);
+	FILE * f = (fd >= 0) ? fdopen(fd, "w+b") : NULL;
+	if (f == NULL) {
+		cerr << "Cannot open tmp file '" << name << "'\n";
+		exit(1);
+	}
+	// Delete the file. However, it stays accessible until it is closed.
+	std::remove(name);
+	return f;
+}
+
+template <class T>
+ExternalQueue::Reader<T>::Reader(FILE * f) : file(f), buffer(BUFSIZE), pos(0), end(0)
+{
+	rewind(file);
+}
+
+// Return 'false' if there are no more values, otherwise store the next value in *v
+template <class T>
+bool ExternalQueue::Reader<T>::next(T * v)
+{
+	if (pos == end) {
+		end = fread(buffer.data(), sizeof(T), BUFSIZE, file);
+		pos = 0;
+		if (end == 0)
+			return false;
+	}
+	*v = buffer[pos++];
+	return true;
+}
+
+/**
+ * Adds a candidate for the next tree depth to the run buffer of thread 'thread'. The
+ * duplicates and the configurations visited before are removed by pushDepth(). Each thread
+ * may only access its own buffer, so the method can be called concurrently by different
+ * threads without synchronization.
+ * If 'forced' is true, the candidate is entered into the next layer without these checks
+ * and without entering it into the visited configurations (see Config::isTunnelPush()).
+ */
+void ExternalQueue::add(int thread, uint64_t conf, uint64_t predIndex, uint64_t box, bool forced)
+{
+	Buffer & buf = buffers[thread];
+	buf.entries.push_back(Entry{conf, (predIndex << 8) | box | (forced ? FORCED : 0)});
+	if (buf.entries.size() == runLength)
+		writeRun(buf);
+}
+
+// Sort the entries of a run buffer, remove the duplicates and write them into a new run
+void ExternalQueue::writeRun(Buffer & buf)
+{
+	// After sorting, the first entry for each configuration has the smallest predecessor index.
+	// Forced entries are kept and do not hide other entries.
+	std::sort(buf.entries.begin(), buf.entries.end());
+	uint64_t n = 0;
+	uint64_t last = ~(uint64_t)0;
+	for (uint64_t i=0; i<buf.entries.size(); i++) {
+		if ((buf.entries[i].predBox & FORCED) != 0)
+			buf.entries[n++] = buf.entries[i];
+		else if (buf.entries[i].conf != last) {
+			last = buf.entries[i].conf;
+			buf.entries[n++] = buf.entries[i];
+		}
+	}
+
+	FILE * f = createFile();
+	if (fwrite(buf.entries.data(), sizeof(Entry), n, f) != n) {
+		cerr << "Cannot write tmp file 'sokoban.ext.*'\n";
+		exit(1);
+	}
+	buf.entries.clear();
+
+	std::lock_guard<std::mutex> lock(runsMutex);
+	runs.push_back(f);
+	file_length += n * sizeof(Entry);
+	max_file_length = std::max(max_file_length, file_length);
+}
+
+/**
+ * Increase the tree depth by one. The runs are merged into the next layer, which becomes
+ * the layer to be read (see read()).
+ */
+void ExternalQueue::pushDepth()
+{
+	// Write the remaining entries of the run buffers
+#pragma omp parallel for schedule(dynamic)
+	for (int t=0; t<nBuffers; t++) {
+		if (!buffers[t].entries.empty())
+			writeRun(buffers[t]);
+	}
+
+	// k-way merge of the runs with a heap containing the next entry of each run. The heap
+	// is ordered such that the smallest entry is on top.
+	typedef std::pair<Entry, uint64_t> HeapEntry;
+	auto greater = [](const HeapEntry & a, const HeapEntry & b) { return b.first < a.first; };
+	std::priority_queue<HeapEntry, std::vector<HeapEntry>, decltype(greater)> heap(greater);
+	std::vector<Reader<Entry> *> readers;
+	for (uint64_t r=0; r<runs.size(); r++) {
+		readers.push_back(new Reader<Entry>(runs[r]));
+		Entry e;
+		if (readers[r]->next(&e))
+			heap.push(HeapEntry(e, r));
+	}
+
+	// Merge the runs with the visited configurations. The new layer contains the entries
+	// whose configurations are neither contained in the visited configurations nor in the
+	// new layer yet. The new file of visited configurations contains the old ones and the
+	// configurations of the new layer. Forced entries are copied into the new layer, but
+	// not into the visited configurations.
+	FILE * layer = createFile();
+	FILE * newVisited = createFile();
+	Reader<uint64_t> old(visited);
+	uint64_t v;
+	bool hasV = old.next(&v);
+	uint64_t length = 0;
+	uint64_t nForced = 0;
+	uint64_t last = ~(uint64_t)0;
+	while (!heap.empty()) {
+		HeapEntry top = heap.top();
+		heap.pop();
+		Entry e;
+		if (readers[top.second]->next(&e))
+			heap.push(HeapEntry(e, top.second));
+
+		if ((top.first.predBox & FORCED) != 0) {
+			fwrite(&top.first, sizeof(Entry), 1, layer);
+			length++;
+			nForced++;
+			continue;
+		}
+
+		// Duplicate within the runs: the first entry has the smallest predecessor index
+		if (top.first.conf == last)
+			continue;
+		last = top.first.conf;
+
+		// Copy the smaller visited configurations and check if the configuration is visited
+		while (hasV && (v < last)) {
+			fwrite(&v, sizeof(v), 1, newVisited);
+			hasV = old.next(&v);
+		}
+		if (hasV && (v == last))
+			continue;
+
+		fwrite(&top.first, sizeof(Entry), 1, layer);
+		fwrite(&last, sizeof(last), 1, newVisited);
+		length++;
+	}
+	while (hasV) {
+		fwrite(&v, sizeof(v), 1, newVisited);
+		hasV = old.next(&v);
+	}
+	if (ferror(layer) || ferror(newVisited)) {
+		cerr << "Cannot write tmp file 'sokoban.ext.*'\n";
+		exit(1);
+	}
+
+	// The runs are no longer needed
+	for (uint64_t r=0; r<runs.size(); r++) {
+		delete readers[r];
+		fclose(runs[r]);
+	}
+	runs.clear();
+	fclose(visited);
+	visited = newVisited;
+	nVisited += length - nForced;
+	layers.push_back(layer);
+	lengths.push_back(length);
+
+	file_length = nVisited * sizeof(uint64_t);
+	for (uint64_t l : lengths)
+		file_length += l * sizeof(Entry);
+	max_file_length = std::max(max_file_length, file_length);
+}
+
+/**
+ * Return the length of the layer to be read.
+ */
+uint64_t ExternalQueue::length()
+{
+	return lengths.back();
+}
+
+/**
+ * Read the entries first ... first+n-1 of the layer to be read. The configurations are
+ * stored in confs[], the moved boxes in boxes[].
+ */
+void ExternalQueue::read(uint64_t first, uint64_t n, uint64_t * confs, uint64_t * boxes)
+{
+	std::vector<Entry> entries(n);
+	FILE * f = layers.back();
+	fseeko(f, first * sizeof(Entry), SEEK_SET);
+	if (fread(entries.data(), sizeof(Entry), n, f) != n) {
+		cerr << "Cannot read tmp file 'sokoban.ext.*'\n";
+		exit(1);
+	}
+	for (uint64_t i=0; i<n; i++) {
+		confs[i] = entries[i].conf;
+		boxes[i] = entries[i].predBox & BOXMASK;
+	}
+}
+
+/**
+ * Return the solution path as an array of configurations. The parameter conf is the
+ * solution configuration, predIndex the index of the predecessor configuration in the layer
+ * to be read. In *path_length the length of the path is returned. The result is allocated
+ * dynamically and should be deallocated using delete[].
+ */
+uint64_t * ExternalQueue::getPath(uint64_t conf, uint64_t predIndex, uint64_t * path_length)
+{
+	uint64_t depth = layers.size();
+	uint64_t * path = new uint64_t[depth+1];
+	path[depth] = conf;
+	uint64_t pos = predIndex;
+
+	// Iterate the path in reversed order
+	for (int64_t k = depth-1; k>=0; k--) {
+		Entry e;
+		fseeko(layers[k], pos * sizeof(Entry), SEEK_SET);
+		if (fread(&e, sizeof(Entry), 1, layers[k]) != 1) {
+			cerr << "Cannot read tmp file 'sokoban.ext.*'\n";
+			exit(1);
+		}
+		path[k] = e.conf;
+		pos = e.predBox >> 8;
+	}
+	*path_length = depth+1;
+	return path;
+}
+
+/**
+ * Returns information about RAM and hard disk usage.
+ */
+void ExternalQueue::statistics()
+{
+	uint64_t size = 0;
+	for (int t=0; t<nBuffers; t++)
+		size += buffers[t].entries.capacity() * sizeof(Entry) / 1024;
+	cout << "Used " << size << " KBytes for run buffers\n";
+
+	size = max_file_length / 1024;
+	cout << "Used " << size << " KBytes for temp files\n";
+}
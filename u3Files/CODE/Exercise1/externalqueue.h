@@ -0,0 +1,152 @@
+#include <cstdio>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * Data structure for an external-memory breadth first search with delayed duplicate detection.
+ * In contrast to BFSQueue, there is no set of visited configurations in main memory. Instead,
+ * all tree depths (layers) and the set of all configurations visited so far are kept in
+ * temporary files, sorted by configuration number:
+ * - While a layer is expanded, the successors are collected in per-thread run buffers. When a
+ *   buffer is full, it is sorted and written to a temporary file (a sorted run).
+ * - At the end of the layer (pushDepth()), the runs are merged (k-way merge). Duplicates within
+ *   the runs are adjacent in the merged sequence, and the configurations visited before are
+ *   removed by merging with the (sorted) file of visited configurations. The result is the next
+ *   layer, and the file of visited configurations is rewritten with the new configurations.
+ * Thus, the main memory only depends on the size of the run buffers, not on the number of
+ * possible configurations. Since Sokoban moves cannot be undone, a successor may have been
+ * visited at any smaller depth, so duplicates are removed against all previous layers, not
+ * just the last two ones (as suffices for undirected graphs).
+ * Each entry of a layer contains the configuration, the index of the predecessor configuration
+ * in the previous layer and the box that was moved. If there are several candidates for a
+ * configuration, the one with the smallest predecessor index is kept, so the search is
+ * independent of the number of threads.
+ */
+class ExternalQueue
+{
+ private:
+	// Entry of a layer or run: configuration number and (index of the predecessor << 8 | box),
+	// where the box is or'ed with FORCED for a forced candidate (see add()). Entries are
+	// ordered by configuration number and then by predecessor index.
+	class Entry {
+	public:
+		uint64_t conf;
+		uint64_t predBox;
+
+		inline bool operator<(const Entry & e) const
+		{
+			return (conf < e.conf) || ((conf == e.conf) && (predBox < e.predBox));
+		}
+	};
+
+	// Sequential reader for a file of values of type T, using a buffer of BUFSIZE values
+	template <class T>
+	class Reader {
+	public:
+		FILE * file;
+		std::vector<T> buffer;
+		uint64_t pos;       // Position of the next value in the buffer
+		uint64_t end;       // Number of values in the buffer
+
+		Reader(FILE * f);
+
+		// Return 'false' if there are no more values, otherwise store the next value in *v
+		bool next(T * v);
+	};
+
+	// Per-thread run buffer. The class is aligned to a cache line to avoid false sharing.
+	class alignas(64) Buffer {
+	public:
+		std::vector<Entry> entries;
+	};
+
+	// Flag for forced candidates in Entry::predBox, and mask for the box
+	static const uint64_t FORCED = 0x80;
+	static const uint64_t BOXMASK = 0x7f;
+
+	// Number of values in the buffer of a Reader
+	static const uint64_t BUFSIZE = 1 << 16;
+
+	// Maximum number of entries in a run buffer
+	uint64_t runLength;
+
+	// Per-thread run buffers and their number (i.e., number of threads)
+	Buffer * buffers;
+	int nBuffers;
+
+	// Sorted runs of the layer that is currently being expanded. 'runsMutex' protects the
+	// list of runs, since threads write their runs concurrently.
+	std::vector<FILE *> runs;
+	std::mutex runsMutex;
+
+	// Layers of the search tree, one file per tree depth, and their lengths
+	std::vector<FILE *> layers;
+	std::vector<uint64_t> lengths;
+
+	// Sorted file of all configurations visited so far, and their number
+	FILE * visited;
+	uint64_t nVisited;
+
+	// Current size and maximum size of all temporary files (in bytes)
+	uint64_t file_length;
+	uint64_t max_file_length;
+
+	// Create a new temporary file. The file is deleted when it is closed.
+	static FILE * createFile();
+
+	// Sort the entries of a run buffer, remove the duplicates and write them into a new run
+	void writeRun(Buffer & buf);
+
+ public:
+	/**
+	 * Constructor: Create a queue that uses at most 'memory' bytes for the run buffers of
+	 * 'nThreads' threads.
+	 */
+	ExternalQueue(uint64_t memory, int nThreads = 1);
+
+	/**
+	 * Destructur: close (and thus delete) the temporary files and deallocate memory.
+	 */
+	~ExternalQueue();
+
+	/**
+	 * Adds a candidate for the next tree depth to the run buffer of thread 'thread'. The
+	 * duplicates and the configurations visited before are removed by pushDepth(). Each thread
+	 * may only access its own buffer, so the method can be called concurrently by different
+	 * threads without synchronization.
+	 * If 'forced' is true, the candidate is entered into the next layer without these checks
+	 * and without entering it into the visited configurations (see Config::isTunnelPush()).
+	 */
+	void add(int thread, uint64_t conf, uint64_t predIndex, uint64_t box, bool forced = false);
+
+	/**
+	 * Increase the tree depth by one. The runs are merged into the next layer, which becomes
+	 * the layer to be read (see read()).
+	 */
+	void pushDepth();
+
+	/**
+	 * Return the length of the layer to be read.
+	 */
+	uint64_t length();
+
+	/**
+	 * Read the entries first ... first+n-1 of the layer to be read. The configurations are
+	 * stored in confs[], the moved boxes in boxes[].
+	 */
+	void read(uint64_t first, uint64_t n, uint64_t * confs, uint64_t * boxes);
+
+	/**
+	 * Return the solution path as an array of configurations. The parameter conf is the
+	 * solution configuration, predIndex the index of the predecessor configuration in the layer
+	 * to be read. In *path_length the length of the path is returned. The result is allocated
+	 * dynamically and should be deallocated using delete[].
+	 */
+	uint64_t * getPath(uint64_t conf, uint64_t predIndex, uint64_t * path_length);
+
+	/**
+	 * Returns information about RAM and hard disk usage.
+	 */
+	void statistics();
+};
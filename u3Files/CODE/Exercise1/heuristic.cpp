@@ -0,0 +1,154 @@
+#include <stdlib.h>
+
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include "converter.h"
+#include "config.h"
+#include "heuristic.h"
+#include "patterndb.h"
+
+
+uint64_t Heuristic::nBox;
+uint64_t Heuristic::nPos;
+uint64_t Heuristic::nBoxConfigs;
+uint64_t * Heuristic::distance;
+std::vector<PatternDB *> Heuristic::patterns;
+
+// =========================================================
+
+/**
+ * Initialize the class for the current playing field (see Playfield::init()). If
+ * 'patternSize' is not 0, pattern databases are used for groups of 'patternSize'
+ * consecutive targets (the last group may be smaller). They are stored in the files
+ * '<prefix>.<first target>-<last target>.pdb'.
+ */
+void Heuristic::init(uint64_t patternSize, const char * prefix)
+{
+	nBox = Playfield::nBox;
+	nPos = Playfield::nPos;
+	nBoxConfigs = Converter::getNumConfigs();
+	distance = new uint64_t[nBox*nPos];
+
+	// For each target g (field number g), a breadth first search with pulls: if a box on
+	// field q can have been pushed into direction 'dir', it came from field p behind q, and
+	// the player stood on the field behind p.
+	std::vector<uint64_t> queue(nPos);
+	for (uint64_t g=0; g<nBox; g++) {
+		uint64_t * dist = &distance[g*nPos];
+		for (uint64_t p=0; p<nPos; p++)
+			dist[p] = INFINITE;
+		dist[g] = 0;
+		uint64_t head = 0;
+		uint64_t tail = 0;
+		queue[tail++] = g;
+		while (head < tail) {
+			uint64_t q = queue[head++];
+			for (uint64_t dir=0; dir<4; dir++) {
+				uint64_t p = Playfield::neighbor[dir ^ 2][q];
+				if (!Playfield::isValid(p) || Playfield::isDead(p) || (dist[p] != INFINITE))
+					continue;
+				if (!Playfield::isValid(Playfield::neighbor[dir ^ 2][p]))
+					continue;
+				dist[p] = dist[q] + 1;
+				queue[tail++] = p;
+			}
+		}
+	}
+
+	// The targets are numbered row by row, so consecutive targets are close to each other
+	for (uint64_t first=0; (patternSize > 0) && (first < nBox); first += patternSize) {
+		uint64_t size = std::min(patternSize, nBox - first);
+		uint64_t goals[Config::MAXBOXES];
+		for (uint64_t i=0; i<size; i++)
+			goals[i] = first + i;
+		std::string fname = std::string(prefix) + "." + std::to_string(first) + "-"
+			+ std::to_string(first + size - 1) + ".pdb";
+		patterns.push_back(new PatternDB(goals, size, fname.c_str()));
+	}
+}
+
+/**
+ * Return a lower bound for the number of pushes needed to solve the configuration with
+ * number 'conf', or Config::NONE if a box cannot reach any target or the boxes cannot be
+ * assigned to different targets.
+ */
+uint64_t Heuristic::estimate(uint64_t conf)
+{
+	uint64_t boxPos[Config::MAXBOXES];
+	Converter::noToConfig(conf % nBoxConfigs, boxPos);
+
+	// Hungarian method for the cost matrix cost(i,j) = distance of box i to target j. The
+	// boxes are added one by one (rows 1...n, index 0 is a dummy); u and v are the potentials
+	// of the rows and columns, match[j] is the row assigned to column j, and way[j] the
+	// previous column on the shortest augmenting path to column j.
+	const int64_t INF = INT64_MAX / 4;
+	uint64_t n = nBox;
+	int64_t u[Config::MAXBOXES+1] = {0};
+	int64_t v[Config::MAXBOXES+1] = {0};
+	uint64_t match[Config::MAXBOXES+1] = {0};
+	uint64_t way[Config::MAXBOXES+1];
+	int64_t minv[Config::MAXBOXES+1];
+	bool used[Config::MAXBOXES+1];
+	for (uint64_t i=1; i<=n; i++) {
+		match[0] = i;
+		uint64_t j0 = 0;
+		for (uint64_t j=0; j<=n; j++) {
+			minv[j] = INF;
+			used[j] = false;
+		}
+		do {
+			used[j0] = true;
+			uint64_t i0 = match[j0];
+			uint64_t j1 = 0;
+			int64_t delta = INF;
+			for (uint64_t j=1; j<=n; j++) {
+				if (used[j])
+					continue;
+				int64_t cur = (int64_t)distance[(j-1)*nPos + boxPos[i0-1]] - u[i0] - v[j];
+				if (cur < minv[j]) {
+					minv[j] = cur;
+					way[j] = j0;
+				}
+				if (minv[j] < delta) {
+					delta = minv[j];
+					j1 = j;
+				}
+			}
+			for (uint64_t j=0; j<=n; j++) {
+				if (used[j]) {
+					u[match[j]] += delta;
+					v[j] -= delta;
+				}
+				else
+					minv[j] -= delta;
+			}
+			j0 = j1;
+		} while (match[j0] != 0);
+		do {
+			uint64_t j1 = way[j0];
+			match[j0] = match[j1];
+			j0 = j1;
+		} while (j0 != 0);
+	}
+
+	// The cost of the matching is -v[0]. It is at least INFINITE if a box has to be
+	// assigned to a target it cannot reach.
+	uint64_t cost = -v[0];
+	if (cost >= INFINITE)
+		return Config::NONE;
+
+	// The playing field is a grid, i.e., the fields can be colored like a chessboard such that
+	// each push moves a box to a field of the other color. Thus, the number of pushes needed
+	// to solve the configuration has the same parity as the cost of the matching, and a larger
+	// lower bound from a pattern database can be rounded up to this parity.
+	uint64_t bound = cost;
+	for (PatternDB * p : patterns) {
+		uint64_t h = p->lookup(boxPos, nBox);
+		if (h == Config::NONE)
+			return Config::NONE;
+		bound = std::max(bound, h);
+	}
+	return bound + ((bound - cost) & 1);
+}
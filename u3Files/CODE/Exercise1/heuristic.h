@@ -0,0 +1,47 @@
+#include <cstdint>
+#include <vector>
+
+class PatternDB;
+
+/**
+ * This class (with only static attributes and methods) computes a lower bound for the number
+ * of pushes needed to solve a configuration, for informed search (see doHeuristicSearch()).
+ * For each target and each field, the number of pushes needed to move a single box from the
+ * field to the target is precomputed, ignoring all other boxes (but taking into account that
+ * the player must stand behind the box). The lower bound is the minimum over all assignments
+ * of the boxes to the targets (one box per target) of the sum of these distances, i.e., a
+ * minimum-cost perfect matching. It is computed with the Hungarian method.
+ * A push changes the distances of one box by at most one, so the lower bound decreases by at
+ * most one per push, i.e., it is consistent.
+ * Optionally, pattern databases for groups of targets (see PatternDB) are used in addition;
+ * the lower bound then is the maximum of the matching and the pattern database values.
+ */
+class Heuristic
+{
+ public:
+	/**
+	 * Initialize the class for the current playing field (see Playfield::init()). If
+	 * 'patternSize' is not 0, pattern databases are used for groups of 'patternSize'
+	 * consecutive targets (the last group may be smaller). They are stored in the files
+	 * '<prefix>.<first target>-<last target>.pdb'.
+	 */
+	static void init(uint64_t patternSize = 0, const char * prefix = NULL);
+
+	/**
+	 * Return a lower bound for the number of pushes needed to solve the configuration with
+	 * number 'conf', or Config::NONE if a box cannot reach any target or the boxes cannot be
+	 * assigned to different targets.
+	 */
+	static uint64_t estimate(uint64_t conf);
+
+ private:
+	static uint64_t nBox;              // Number of boxes (and targets)
+	static uint64_t nPos;              // Number of fields that may contain a box
+	static uint64_t nBoxConfigs;       // Number of configurations of the boxes
+	static uint64_t * distance;        // distance[g*nPos+p]: pushes from field p to target g
+	static std::vector<PatternDB *> patterns; // Pattern databases
+
+	// Distance for fields from which a target cannot be reached. It is larger than the sum of
+	// all finite distances.
+	static const uint64_t INFINITE = (uint64_t)1 << 32;
+};
@@ -0,0 +1,304 @@
+#include <stdlib.h>
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <omp.h>
+
+#include "config.h"
+#include "patterndb.h"
+
+using namespace std;
+
+/**
+ * Pattern database: lower bounds for the number of pushes needed to move boxes onto a subset
+ * (pattern) of the targets, computed by a breadth first search with pulls in the problem
+ * reduced to the boxes of the pattern.
+ */
+
+
+// Return the number of the connected component of the fields without boxes in 'boxes'
+// that contains field 'pos' (numbered as in Config::findComponent()).
+static uint64_t findComponent(const Bitboard & boxes, uint64_t pos)
+{
+	Bitboard remaining = Playfield::fieldMask & ~boxes;
+	uint64_t target = Playfield::gridPos[pos];
+	for (uint64_t cn = 0; ; cn++) {
+		Bitboard c = Playfield::fill(Bitboard::single(remaining.lowest()), remaining);
+		if (c.test(target))
+			return cn;
+		remaining &= ~c;
+	}
+}
+
+// Return the connected component with number 'n' of the fields without boxes in 'boxes'
+// (an empty set, if there is none).
+static Bitboard getComponent(const Bitboard & boxes, uint64_t n)
+{
+	Bitboard remaining = Playfield::fieldMask & ~boxes;
+	for (uint64_t cn = 0; !remaining.isEmpty(); cn++) {
+		Bitboard c = Playfield::fill(Bitboard::single(remaining.lowest()), remaining);
+		if (cn == n)
+			return c;
+		remaining &= ~c;
+	}
+	return remaining;
+}
+
+/**
+ * Constructor: Create the pattern database for the targets goals[0 ... size-1] of the
+ * current level (see Playfield). The table is read from the file 'fname', or computed
+ * and stored in this file, if it does not exist or belongs to another pattern.
+ */
+PatternDB::PatternDB(const uint64_t goals[], uint64_t size, const char * fname)
+{
+	this->size = size;
+	this->goals = 0;
+	for (uint64_t i=0; i<size; i++)
+		this->goals |= (uint64_t)1 << goals[i];
+
+	// (m k) = (m-1 k-1) + (m-1 k)
+	nPos = Playfield::nPos;
+	binom = new uint64_t[(size+1)*(nPos+1)]();
+	for (uint64_t m=0; m<=nPos; m++) {
+		binom[m] = 1;
+		for (uint64_t j=1; j<=size && j<=m; j++)
+			binom[j*(nPos+1) + m] = binom[(j-1)*(nPos+1) + m-1] + binom[j*(nPos+1) + m-1];
+	}
+	nEntries = binom[size*(nPos+1) + nPos];
+
+	if (!load(fname)) {
+		build(fname);
+		if (!load(fname)) {
+			cerr << "Cannot read pattern database file '" << fname << "'\n";
+			exit(1);
+		}
+	}
+}
+
+/**
+ * Destructur: unmap and close the file.
+ */
+PatternDB::~PatternDB()
+{
+	munmap((void *)(table - HEADERSIZE), file_length);
+	close(file);
+	delete[] binom;
+}
+
+// Configuration number of the sorted box positions pos[0 ... size-1]
+uint64_t PatternDB::rank(const uint64_t pos[])
+{
+	uint64_t sum = 0;
+	for (uint64_t i=0; i<size; i++)
+		sum += term(pos[i], i);
+	return nEntries - 1 - sum;
+}
+
+// Box positions pos[0 ... size-1] of the configuration number 'no' (see
+// Converter::noToConfig())
+void PatternDB::unrank(uint64_t no, uint64_t pos[])
+{
+	uint64_t rest = nEntries - 1 - no;
+	uint64_t c = nPos;
+	for (uint64_t i=0; i<size; i++) {
+		const uint64_t * row = &binom[(size-i)*(nPos+1)];
+		do {
+			c--;
+		} while (row[c] > rest);
+		rest -= row[c];
+		pos[i] = nPos-1-c;
+	}
+}
+
+// Map the file 'fname' into memory. Returns 'false' if the file does not exist or does
+// not belong to the playing field and the pattern.
+bool PatternDB::load(const char * fname)
+{
+	struct stat st;
+	file = open(fname, O_RDONLY);
+	if (file < 0)
+		return false;
+	if ((fstat(file, &st) != 0) || ((uint64_t)st.st_size != HEADERSIZE + nEntries)) {
+		close(file);
+		return false;
+	}
+	file_length = st.st_size;
+	void * m = mmap(NULL, file_length, PROT_READ, MAP_SHARED, file, 0);
+	if (m == MAP_FAILED) {
+		close(file);
+		return false;
+	}
+	const Header * header = (const Header *)m;
+	if ((header->magic != MAGIC) || (header->fingerprint != Playfield::fingerprint())
+		|| (header->size != size) || (header->goals != goals)
+		|| (header->nEntries != nEntries)) {
+		munmap(m, file_length);
+		close(file);
+		return false;
+	}
+	table = (const unsigned char *)m + HEADERSIZE;
+	return true;
+}
+
+// Compute the table and store it in the file 'fname'
+void PatternDB::build(const char * fname)
+{
+	// Distances of the states of the reduced problem, i.e., configurations of the boxes and
+	// connected components of the player (see Config)
+	uint64_t nComp = 1 + 3*size;
+	vector<unsigned char> dist(nEntries * nComp, UNREACHABLE);
+
+	// The solved states have the distance 0: the boxes are on the targets of the pattern,
+	// the player may be in any connected component.
+	vector<uint64_t> layer;
+	uint64_t pos[Config::MAXBOXES];
+	Bitboard boxes = Bitboard::empty();
+	uint64_t i = 0;
+	for (uint64_t g=0; g<Playfield::nBox; g++) {
+		if ((goals & ((uint64_t)1 << g)) != 0) {
+			pos[i++] = g;
+			boxes.set(Playfield::gridPos[g]);
+		}
+	}
+	for (uint64_t c=0; (c < nComp) && !getComponent(boxes, c).isEmpty(); c++) {
+		uint64_t s = rank(pos) * nComp + c;
+		dist[s] = 0;
+		layer.push_back(s);
+	}
+
+	// Breadth first search with pulls (see Config::getPrevConfig()). As in DistanceDB::build(),
+	// the threads collect the new states in their own vectors, and the distances are written
+	// afterwards.
+	int nThreads = omp_get_max_threads();
+	vector<vector<uint64_t>> next(nThreads);
+	uint64_t depth = 0;
+	while (!layer.empty()) {
+		if (depth + 1 >= UNREACHABLE) {
+			cerr << "Error: distance larger than " << (UNREACHABLE - 1) << "!" << endl;
+			exit(1);
+		}
+
+#pragma omp parallel for schedule(dynamic, 256)
+		for (uint64_t j=0; j<layer.size(); j++) {
+			vector<uint64_t> & prev = next[omp_get_thread_num()];
+			uint64_t p[Config::MAXBOXES];
+			uint64_t q[Config::MAXBOXES];
+			unrank(layer[j] / nComp, p);
+			Bitboard grid = Bitboard::empty();
+			for (uint64_t b=0; b<size; b++)
+				grid.set(Playfield::gridPos[p[b]]);
+			Bitboard reach = getComponent(grid, layer[j] % nComp);
+
+			for (uint64_t b=0; b<size; b++) {
+				for (uint64_t dir=0; dir<4; dir++) {
+					// The box came from 'oldPos', the player stood on 'playerPos'
+					uint64_t oldPos = Playfield::neighbor[dir ^ 2][p[b]];
+					if (!Playfield::isValid(oldPos) || Playfield::isDead(oldPos)
+						|| !reach.test(Playfield::gridPos[oldPos]))
+						continue;
+					uint64_t playerPos = Playfield::neighbor[dir ^ 2][oldPos];
+					if (!Playfield::isValid(playerPos) || !reach.test(Playfield::gridPos[playerPos]))
+						continue;
+
+					for (uint64_t k=0; k<size; k++)
+						q[k] = (k == b) ? oldPos : p[k];
+					sort(q, q + size);
+					Bitboard newGrid = grid;
+					newGrid.clear(Playfield::gridPos[p[b]]);
+					newGrid.set(Playfield::gridPos[oldPos]);
+					uint64_t comp = findComponent(newGrid, playerPos);
+					if (comp >= nComp) {
+						cerr << "Error: too many connected components!" << endl;
+						exit(1);
+					}
+					uint64_t s = rank(q) * nComp + comp;
+					if (dist[s] == UNREACHABLE)
+						prev.push_back(s);
+				}
+			}
+		}
+
+		depth++;
+		layer.clear();
+		for (int t=0; t<nThreads; t++) {
+			for (uint64_t s : next[t]) {
+				if (dist[s] == UNREACHABLE) {
+					dist[s] = depth;
+					layer.push_back(s);
+				}
+			}
+			next[t].clear();
+		}
+	}
+
+	// The table contains the minimum over the components of the player
+	uint64_t length = HEADERSIZE + nEntries;
+	int fd = open(fname, O_RDWR|O_CREAT|O_TRUNC, 0644);
+	if ((fd < 0) || (ftruncate(fd, length) != 0)) {
+		cerr << "Cannot create pattern database file '" << fname << "'\n";
+		exit(1);
+	}
+	void * m = mmap(NULL, length, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	if (m == MAP_FAILED) {
+		cerr << "Cannot map pattern database file '" << fname << "'\n";
+		exit(1);
+	}
+	unsigned char * t = (unsigned char *)m + HEADERSIZE;
+	for (uint64_t e=0; e<nEntries; e++)
+		t[e] = *min_element(&dist[e*nComp], &dist[e*nComp] + nComp);
+
+	Header * header = (Header *)m;
+	header->magic = MAGIC;
+	header->fingerprint = Playfield::fingerprint();
+	header->size = size;
+	header->goals = goals;
+	header->nEntries = nEntries;
+	cerr << "Pattern database '" << fname << "': " << nEntries << " entries, "
+		 << "maximum distance: " << (depth - 1) << endl;
+
+	if (msync(m, length, MS_SYNC) != 0) {
+		cerr << "Cannot write pattern database file '" << fname << "'\n";
+		exit(1);
+	}
+	munmap(m, length);
+	close(fd);
+}
+
+// Minimum of the table entries over all subsets of the boxes boxPos[first ... n-1] that
+// complete the subset with the boxes 0 ... i-1 of the pattern, whose terms sum up to 'sum'
+void PatternDB::search(const uint64_t boxPos[], uint64_t n, uint64_t first, uint64_t i,
+					   uint64_t sum, unsigned char & best)
+{
+	if (i == size) {
+		best = min(best, table[nEntries - 1 - sum]);
+		return;
+	}
+	for (uint64_t j=first; (j + size - i <= n) && (best > 0); j++)
+		search(boxPos, n, j+1, i+1, sum + term(boxPos[j], i), best);
+}
+
+/**
+ * Return a lower bound for the number of pushes needed to move some of the 'n' boxes at
+ * the (sorted) positions boxPos[] onto the targets of the pattern, or Config::NONE if
+ * this is impossible.
+ */
+uint64_t PatternDB::lookup(const uint64_t boxPos[], uint64_t n)
+{
+	unsigned char best = UNREACHABLE;
+	search(boxPos, n, 0, 0, 0, best);
+	return (best == UNREACHABLE) ? Config::NONE : best;
+}
+
+/**
+ * Return the number of bytes of the table.
+ */
+uint64_t PatternDB::memory()
+{
+	return nEntries;
+}
@@ -0,0 +1,100 @@
+#include <cstdint>
+
+/**
+ * Pattern database: lower bounds for the number of pushes needed to move boxes onto a subset
+ * (pattern) of the targets. The reduced problem only contains 'size' boxes, which have to be
+ * moved onto the targets of the pattern; all other boxes are removed. It is solved exactly by
+ * a breadth first search with pulls from the solved state (as in DistanceDB). The table
+ * contains one byte per configuration of the 'size' boxes, numbered as in Converter, with the
+ * minimum over the positions of the player.
+ * In a configuration of the full problem, some 'size' boxes must be moved onto the targets of
+ * the pattern, which needs at least as many pushes as in the reduced problem. Thus, the
+ * minimum of the table entries over all subsets of 'size' boxes is a lower bound (see
+ * lookup()).
+ * The table is stored in a file, which is mapped into memory. If the file already exists and
+ * belongs to the playing field and the pattern, it is reused.
+ */
+class PatternDB
+{
+ private:
+	// Header at the beginning of the file. The table starts at offset HEADERSIZE.
+	class Header {
+	public:
+		uint64_t magic;
+		uint64_t fingerprint;  // See Playfield::fingerprint()
+		uint64_t size;         // Number of targets in the pattern
+		uint64_t goals;        // Bit set of the targets in the pattern
+		uint64_t nEntries;     // Number of table entries
+	};
+
+	static const uint64_t MAGIC = 0x31424450424f4b53ULL; // "SKOBPDB1"
+	static const uint64_t HEADERSIZE = 4096;
+
+	// Table entry of the configurations from which the pattern cannot be solved. It is also
+	// the limit for the distances.
+	static const unsigned char UNREACHABLE = 255;
+
+	// Pattern: number of targets and bit set of the targets (target g is field g)
+	uint64_t size;
+	uint64_t goals;
+
+	// Number of fields that may contain a box, and binomial coefficients for the numbering
+	// of the configurations (see Converter): binom[k*(nPos+1)+m] contains m over k.
+	uint64_t nPos;
+	uint64_t * binom;
+
+	// Number of table entries, i.e., configurations of 'size' boxes
+	uint64_t nEntries;
+
+	// Memory-mapped file and its length (in bytes)
+	int file;
+	uint64_t file_length;
+	const unsigned char * table;
+
+	// Term of the box with index 'i' on field 'pos' in the configuration number
+	inline uint64_t term(uint64_t pos, uint64_t i)
+	{
+		return binom[(size-i)*(nPos+1) + nPos-1-pos];
+	}
+
+	// Configuration number of the sorted box positions pos[0 ... size-1], and vice versa
+	uint64_t rank(const uint64_t pos[]);
+	void unrank(uint64_t no, uint64_t pos[]);
+
+	// Map the file 'fname' into memory. Returns 'false' if the file does not exist or does
+	// not belong to the playing field and the pattern.
+	bool load(const char * fname);
+
+	// Compute the table and store it in the file 'fname'
+	void build(const char * fname);
+
+	// Minimum of the table entries over all subsets of the boxes boxPos[first ... n-1] that
+	// complete the subset with the boxes 0 ... i-1 of the pattern, whose terms sum up to 'sum'
+	void search(const uint64_t boxPos[], uint64_t n, uint64_t first, uint64_t i, uint64_t sum,
+				unsigned char & best);
+
+ public:
+	/**
+	 * Constructor: Create the pattern database for the targets goals[0 ... size-1] of the
+	 * current level (see Playfield). The table is read from the file 'fname', or computed
+	 * and stored in this file, if it does not exist or belongs to another pattern.
+	 */
+	PatternDB(const uint64_t goals[], uint64_t size, const char * fname);
+
+	/**
+	 * Destructur: unmap and close the file.
+	 */
+	~PatternDB();
+
+	/**
+	 * Return a lower bound for the number of pushes needed to move some of the 'n' boxes at
+	 * the (sorted) positions boxPos[] onto the targets of the pattern, or Config::NONE if
+	 * this is impossible.
+	 */
+	uint64_t lookup(const uint64_t boxPos[], uint64_t n);
+
+	/**
+	 * Return the number of bytes of the table.
+	 */
+	uint64_t memory();
+};
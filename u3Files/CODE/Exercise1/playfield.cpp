@@ -99,6 +99,31 @@ uint64_t Playfield::nPos;
  */
 uint64_t Playfield::nFields;
 
+/**
+ * Bit number of each field in the bit boards (see class Bitboard), i.e., y*width+x
+ * for the field at (x,y).
+ */
+uint64_t * Playfield::gridPos;
+
+/**
+ * Bit board containing all fields (i.e., all cells that are not walls).
+ */
+Bitboard Playfield::fieldMask;
+
+/**
+ * Bit boards containing the targets and the fields that may contain a box (i.e., the
+ * fields that are not dead-end fields).
+ */
+Bitboard Playfield::goalMask;
+Bitboard Playfield::liveMask;
+
+/**
+ * Tunnels: for each field that may contain a box, bit 'dir' of tunnel[pos] is set, if
+ * 'pos' is not a target, and both 'pos' and its neighbor in direction 'dir' have walls on
+ * both sides (i.e., they lie inside a corridor of width one) and may contain a box.
+ */
+uint64_t * Playfield::tunnel;
+
    
 // ==================================================================
 
@@ -162,6 +187,48 @@ void Playfield::init(std::vector<std::string> field)
 		exit(1);
 	}
 
+	// (1b) Determine the simple dead-end fields: a box can only be moved onto a target from
+	// the fields that can be reached from a target by pulling the box, i.e., the field next to
+	// the box and the field behind it (where the player steps back) must not be walls. All
+	// other empty fields are marked as dead-end fields, so that they are numbered behind the
+	// fields that may contain a box, and 'nPos' becomes as small as possible. Fields marked
+	// in the file stay dead-end fields; fields with a box are left as they are.
+	std::vector<std::vector<bool>> live(ny, std::vector<bool>(nx, false));
+	std::vector<std::pair<uint64_t, uint64_t>> pending;
+	auto isField = [&](uint64_t x, uint64_t y) {
+		return (x < nx) && (y < ny) && (field[y][x] != _wall);
+	};
+	for (uint64_t y=0; y<ny; y++) {
+		for (uint64_t x=0; x<nx; x++) {
+			if ((field[y][x] == _goal) || (field[y][x] == _goalBox)) {
+				live[y][x] = true;
+				pending.push_back(std::make_pair(x, y));
+			}
+		}
+	}
+	static const int64_t dx[4] = {-1, 0, 1, 0};
+	static const int64_t dy[4] = {0, -1, 0, 1};
+	while (!pending.empty()) {
+		uint64_t x = pending.back().first;
+		uint64_t y = pending.back().second;
+		pending.pop_back();
+		for (uint64_t d=0; d<4; d++) {
+			uint64_t bx = x + dx[d];
+			uint64_t by = y + dy[d];
+			if (isField(bx, by) && isField(bx + dx[d], by + dy[d])
+				&& !live[by][bx] && (field[by][bx] != _dead)) {
+				live[by][bx] = true;
+				pending.push_back(std::make_pair(bx, by));
+			}
+		}
+	}
+	for (uint64_t y=0; y<ny; y++) {
+		for (uint64_t x=0; x<nx; x++) {
+			if (!live[y][x] && (field[y][x] == _empty))
+				field[y][x] = _dead;
+		}
+	}
+
 	// (2) Determine the number of fields, boxes and targets.
 	nFields = 0;
 	nPos = 0;
@@ -190,6 +257,11 @@ void Playfield::init(std::vector<std::string> field)
 		std::cerr << "Error: #Boxes != #Goals!" << std::endl;
 		exit(1);
 	}
+	if ((nx >= 64) || (nx * ny > Bitboard::MAXBITS)) {
+		std::cerr << "Error: playing field is too large! (" << (nx * ny) << " cells, "
+				  << "at most " << Bitboard::MAXBITS << ", see BITBOARD_WORDS)" << std::endl;
+		exit(1);
+	}
 
 	// (3) Allocate the position arrays and initialize them
 	uint64_t * xPos = new uint64_t[nFields];
@@ -251,6 +323,34 @@ void Playfield::init(std::vector<std::string> field)
 		neighbor[3][i] = posNo[yPos[i]+1][xPos[i]];
 	}
 
+	// (5b) Compile the bit board positions
+	gridPos = new uint64_t[nFields];
+	fieldMask = Bitboard::empty();
+	goalMask = Bitboard::empty();
+	liveMask = Bitboard::empty();
+	for (i=0; i<nFields; i++) {
+		gridPos[i] = yPos[i] * nx + xPos[i];
+		fieldMask.set(gridPos[i]);
+		if (isGoal(i))
+			goalMask.set(gridPos[i]);
+		if (!isDead(i))
+			liveMask.set(gridPos[i]);
+	}
+
+	// (5c) Find the tunnels. The walls on both sides of a field in direction 'dir' are the
+	// neighbors in the directions (dir+1)%4 and (dir+3)%4.
+	tunnel = new uint64_t[nPos];
+	for (i=0; i<nPos; i++) {
+		tunnel[i] = 0;
+		for (uint64_t d=0; d<4; d++) {
+			uint64_t front = neighbor[d][i];
+			if (!isGoal(i) && isValid(front) && !isDead(front)
+				&& !isValid(neighbor[(d+1)%4][i]) && !isValid(neighbor[(d+3)%4][i])
+				&& !isValid(neighbor[(d+1)%4][front]) && !isValid(neighbor[(d+3)%4][front]))
+				tunnel[i] |= (uint64_t)1 << d;
+		}
+	}
+
 	// (6a) Store the initial position of the player
 	initialPlayerPos = posNo[playerY][playerX];
 	
@@ -276,6 +376,25 @@ void Playfield::init(std::vector<std::string> field)
 }
 
 
+/**
+ * Return a fingerprint of the playing field, i.e., of the topology of the fields, the
+ * targets and the number of boxes (FNV-1a hash). Data computed for the playing field and
+ * stored in a file (see DistanceDB, PatternDB) can only be used if the fingerprints are equal.
+ */
+uint64_t Playfield::fingerprint()
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+	auto add = [&h](uint64_t v) { h = (h ^ v) * 0x100000001b3ULL; };
+	add(nFields);
+	add(nPos);
+	add(nBox);
+	for (uint64_t d=0; d<4; d++) {
+		for (uint64_t i=0; i<nFields; i++)
+			add(neighbor[d][i]);
+	}
+	return h;
+}
+
 /**
  * Print a configuration 'graphically'.
  */
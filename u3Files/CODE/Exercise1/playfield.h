@@ -2,6 +2,8 @@
 #include <vector>
 #include <cstdint>
 
+#include "bitboard.h"
+
 class Config;
 
 /**
@@ -74,6 +76,33 @@ class Playfield
 	 * Total number of fields.
 	 */
 	static uint64_t nFields;
+
+	/**
+	 * Bit number of each field in the bit boards (see class Bitboard), i.e., y*width+x
+	 * for the field at (x,y).
+	 */
+	static uint64_t * gridPos;
+
+	/**
+	 * Bit board containing all fields (i.e., all cells that are not walls).
+	 */
+	static Bitboard fieldMask;
+
+	/**
+	 * Bit boards containing the targets and the fields that may contain a box (i.e., the
+	 * fields that are not dead-end fields).
+	 */
+	static Bitboard goalMask;
+	static Bitboard liveMask;
+
+	/**
+	 * Tunnels: for each field that may contain a box, bit 'dir' of tunnel[pos] is set, if
+	 * 'pos' is not a target, and both 'pos' and its neighbor in direction 'dir' have walls on
+	 * both sides (i.e., they lie inside a corridor of width one) and may contain a box. A box
+	 * that has just been pushed onto such a field in direction 'dir' is pushed on through the
+	 * tunnel (see Config::getTunnelDir()).
+	 */
+	static uint64_t * tunnel;
    
 	// ==================================================================
 
@@ -113,6 +142,61 @@ class Playfield
 		return pos >= nPos;
 	}
 
+	/**
+	 * Flood fill: returns the set of fields in 'free' that can be reached from the fields
+	 * in 'seed' by moving horizontally and vertically through fields in 'free'. Each step
+	 * extends the set by one field in all four directions using shift and mask operations.
+	 */
+	static inline Bitboard fill(Bitboard seed, const Bitboard & free)
+	{
+		for (;;) {
+			Bitboard next = (seed | (seed << 1) | (seed >> 1)
+							 | (seed << (unsigned)nx) | (seed >> (unsigned)nx)) & free;
+			if (next == seed)
+				return seed;
+			seed = next;
+		}
+	}
+
+	/**
+	 * Return a fingerprint of the playing field, i.e., of the topology of the fields, the
+	 * targets and the number of boxes. Data computed for the playing field and stored in a
+	 * file (see DistanceDB, PatternDB) can only be used if the fingerprints are equal.
+	 */
+	static uint64_t fingerprint();
+
+	/**
+	 * Return the set of fields that are horizontally or vertically adjacent to a field
+	 * in 'b'.
+	 */
+	static inline Bitboard neighbors(const Bitboard & b)
+	{
+		return ((b << 1) | (b >> 1) | (b << (unsigned)nx) | (b >> (unsigned)nx)) & fieldMask;
+	}
+
+	/**
+	 * Return the boxes in 'boxes' that can never be moved again (frozen boxes). A box can be
+	 * moved horizontally if neither its left nor its right neighbor is a wall or a frozen
+	 * box, and at least one of them is not a dead-end field; vertically analogously. Starting
+	 * with all boxes, the boxes that can be moved are removed until nothing changes. Thus,
+	 * a group of boxes that block each other (e.g., four boxes, or boxes and walls, in a 2x2
+	 * square) remains frozen.
+	 */
+	static inline Bitboard frozenBoxes(const Bitboard & boxes)
+	{
+		Bitboard frozen = boxes;
+		for (;;) {
+			Bitboard open = fieldMask & ~frozen;
+			Bitboard h = (open << 1) & (open >> 1) & ((liveMask << 1) | (liveMask >> 1));
+			Bitboard v = (open << (unsigned)nx) & (open >> (unsigned)nx)
+				& ((liveMask << (unsigned)nx) | (liveMask >> (unsigned)nx));
+			Bitboard next = frozen & ~(h | v);
+			if (next == frozen)
+				return frozen;
+			frozen = next;
+		}
+	}
+
 	/**
 	 * Print a configuration 'graphically'.
 	 */
@@ -6,12 +6,20 @@
 #include <chrono>
 #include <cstdint>
 #include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <omp.h>
 
 #include "converter.h"
 #include "config.h"
 #include "bfsqueue.h"
 #include "dfsstack.h"
 #include "dfsdepthmap.h"
+#include "externalqueue.h"
+#include "statemap.h"
+#include "distancedb.h"
+#include "heuristic.h"
 
 /**
  * This program solves the game 'Sokoban'. The goal of the game is to push boxes
@@ -68,6 +76,62 @@ static void printPath(uint64_t path[], uint64_t length)
 	}
 }
 
+/**
+ * Expand the configuration 'conf' with index 'i' in the layer of depth 'depth-1' of a breadth
+ * first search, whose box positions 'boxPos' have been determined with
+ * Config::boxPositions(), where 'lastBox' is the box that was moved last ('moved' is false for the
+ * starting configuration, which has not been reached by a push): all successor configurations
+ * are added to the buffer of the calling thread in 'queue' (a BFSQueue or ExternalQueue).
+ * If a successor is a solution, it is stored in 'solution' and 'i' in 'solutionIndex', if 'i'
+ * is smaller than the index of all solutions found before. Thus, the same solution is found
+ * for any number of threads. (A solution configuration cannot have been examined before,
+ * since the search would have been terminated.)
+ */
+template <class Queue>
+static void expandConfig(Queue *queue, uint64_t i, uint64_t conf, const uint64_t *boxPos,
+						 uint64_t lastBox, bool moved, std::atomic<uint64_t> &solutionIndex,
+						 uint64_t &solution)
+{
+	uint64_t nBoxes = Config::numBoxes(); // Number of boxes
+	Config newConf(conf, boxPos);
+	// If the last push must be continued through a tunnel, this is the only push considered
+	uint64_t tunnelDir = moved ? newConf.getTunnelDir(lastBox) : Config::NONE;
+	// Consider all boxes, starting with the box that was moved last
+	for (uint64_t b = 0; b < nBoxes; b++)
+	{
+		uint64_t box = (b + lastBox) % nBoxes;
+		// Consider all directions of movement
+		for (uint64_t dir = 0; dir < 4; dir++)
+		{
+			if ((tunnelDir != Config::NONE) && ((box != lastBox) || (dir != tunnelDir)))
+				continue;
+			// Determine the configuration that results from moving box
+			// 'box' in direction 'dir'.
+			uint64_t newBox;
+			uint64_t c = newConf.getNextConfig(box, dir, &newBox);
+			// If the move is valid, add the resulting configuration to this thread's
+			// buffer for the next depth. The buffer checks whether it has been
+			// examined before, unless the tunnel macro restricts its pushes.
+			if (c != Config::NONE)
+			{
+				queue->add(omp_get_thread_num(), c, i, newBox,
+						   newConf.isTunnelPush(box, dir, c, newBox));
+				// If we found a solution: remember it and stop
+				if (Config::isSolutionConf(c))
+				{
+#pragma omp critical
+					if (i < solutionIndex.load(std::memory_order_relaxed))
+					{
+						solution = c;
+						solutionIndex.store(i, std::memory_order_relaxed);
+					}
+					return;
+				}
+			}
+		}
+	}
+}
+
 /**
  * Execute a breadth first search from the given starting configuration, in order to find a
  * solution. The search tree is examined layer by layer from top to bottom. For configurations
@@ -75,70 +139,76 @@ static void printPath(uint64_t path[], uint64_t length)
  * and entered into the queue for depth 'depth', if they have not already been examined
  * previously.
  */
-static void doBreadthFirstSearch(Config *conf)
+static void doBreadthFirstSearch(Config *conf, VisitedSet::Kind visitedKind)
 {
 	// Create the queue for the configurations to be examined.
 	// At the beginning, the queue just contains the starting configuration.
-	BFSQueue *queue = new BFSQueue(Config::getNumConfigs());
+	BFSQueue *queue = new BFSQueue(Config::getNumConfigs(), Config::numBoxes(),
+									omp_get_max_threads(), visitedKind);
 	queue->lookup_and_add(conf->getConfig(), -1, 0);
 	queue->pushDepth();
 
-	uint64_t nBoxes = Config::numBoxes(); // Number of boxes
 	uint64_t depth = 1;					  // Tree depth
 	uint64_t length = queue->length();	  // Number of configurations at depth 'depth-1'
-	uint64_t lastBox;					  // Box that was moved last
 
 	// Pass through all layers of the tree with increasing depth until there are no
-	// configurations with this depth any more.
-	bool Flag_SoluFound = false;
+	// configurations with this depth any more or a solution has been found.
 	while (length > 0)
 	{
 		// Print the progress
 		std::cerr << "depth " << depth << ": " << length << std::endl
 				  << std::flush;
-// Consider all configurations of depth 'depth-1'.
-	uint64_t newBox;
-#pragma omp parallel for private(lastBox,newBox)
-		for (uint64_t i = 0; i < length; i++)
+
+		// Index (in the read queue) of the first configuration found so far that has a
+		// solution configuration as successor, and this solution configuration. Once a
+		// solution has been found, the threads skip all chunks and configurations behind it,
+		// i.e., the remaining work of this tree depth is cancelled.
+		std::atomic<uint64_t> solutionIndex(Config::NONE);
+		uint64_t solution = Config::NONE;
+
+		// Consider all configurations of depth 'depth-1' in chunks of CHUNK configurations.
+		// The static schedule assigns contiguous ranges of the read queue to the threads in
+		// the order of the thread numbers, so the next depth is the same for any number of
+		// threads (see BFSQueue::pushDepth()). The configurations of a chunk are read from
+		// the queue first, so that their box positions can be determined at once.
+		const uint64_t CHUNK = 1024;
+		uint64_t nChunks = (length + CHUNK - 1) / CHUNK;
+#pragma omp parallel
 		{
-			// Read the configuration from the queue
-			Config newConf(queue->get(i, &lastBox));
-			// Consider all boxes, starting with the box that was moved last
-			for (uint64_t b = 0; b < nBoxes; b++)
+			std::vector<uint64_t> confs(CHUNK), boxes(CHUNK), boxPos(CHUNK * Config::numBoxes());
+#pragma omp for schedule(static)
+			for (uint64_t chunk = 0; chunk < nChunks; chunk++)
 			{
-				uint64_t box = (b + lastBox) % nBoxes;
-				// Consider all directions of movement
-				for (uint64_t dir = 0; dir < 4 && !Flag_SoluFound; dir++)
+				uint64_t first = chunk * CHUNK;
+				uint64_t n = (length - first < CHUNK) ? length - first : CHUNK;
+				// Stop if a solution has been found for an earlier configuration
+				if (first > solutionIndex.load(std::memory_order_relaxed))
+					continue;
+				for (uint64_t j = 0; j < n; j++)
+					confs[j] = queue->get(first + j, &boxes[j]);
+				Config::boxPositions(confs.data(), n, boxPos.data());
+				for (uint64_t j = 0; j < n; j++)
 				{
-					// Determine the configuration that results from moving box
-					// 'box' in direction 'dir'.
-					uint64_t c = newConf.getNextConfig(box, dir, &newBox);
-					// If the move is valid, check whether the resuling configuration has
-					// been examined before. If not, add it to the queue
-					if (c != Config::NONE)
-					{
-						bool CheckconfiAdded = false;
-                        #pragma omp critical
-						CheckconfiAdded = queue->lookup_and_add(c, i, newBox);
-						if (CheckconfiAdded)
-						{
-							// If we found a solution: print it and terminate the search
-							if (Config::isSolutionConf(c))
-							{								
-								uint64_t len;
-								uint64_t *path = queue->getPath(c, i, &len);
-								printPath(path, len);
-								delete[] path;
-								queue->statistics();
-								Flag_SoluFound = true;
-								//return;
-							}
-						}
-					}
+					if (first + j > solutionIndex.load(std::memory_order_relaxed))
+						break;
+					expandConfig(queue, first + j, confs[j], &boxPos[j * Config::numBoxes()],
+								 boxes[j], depth > 1, solutionIndex, solution);
 				}
 			}
 		}
 
+		// If we found a solution: print it and terminate the search
+		if (solution != Config::NONE)
+		{
+			uint64_t len;
+			uint64_t *path = queue->getPath(solution, solutionIndex, &len);
+			printPath(path, len);
+			delete[] path;
+			queue->statistics();
+			delete queue;
+			return;
+		}
+
 		// Advance the queue for the next tree depth
 		depth++;
 		queue->pushDepth();
@@ -149,15 +219,456 @@ static void doBreadthFirstSearch(Config *conf)
 	// If the loop exits normally, there is no solution
 	std::cout << "No solution found!" << std::endl;
 	queue->statistics();
+	delete queue;
+}
+
+/**
+ * Execute a breadth first search with delayed duplicate detection in external memory (see
+ * ExternalQueue), using at most 'memory' bytes for the run buffers. Otherwise, the search
+ * works like doBreadthFirstSearch(), but the configurations of depth 'depth-1' are read from
+ * the temporary file in slices of SLICE configurations.
+ */
+static void doExternalSearch(Config *conf, uint64_t memory)
+{
+	// Create the queue for the configurations to be examined.
+	// At the beginning, the queue just contains the starting configuration.
+	ExternalQueue *queue = new ExternalQueue(memory, omp_get_max_threads());
+	queue->add(0, conf->getConfig(), 0, 0);
+	queue->pushDepth();
+
+	const uint64_t SLICE = 1 << 16;
+	uint64_t *confs = new uint64_t[SLICE];
+	uint64_t *boxes = new uint64_t[SLICE];
+	uint64_t *boxPos = new uint64_t[SLICE * Config::numBoxes()];
+	uint64_t depth = 1;					  // Tree depth
+	uint64_t length = queue->length();	  // Number of configurations at depth 'depth-1'
+
+	// Pass through all layers of the tree with increasing depth until there are no
+	// configurations with this depth any more or a solution has been found.
+	while (length > 0)
+	{
+		// Print the progress
+		std::cerr << "depth " << depth << ": " << length << std::endl
+				  << std::flush;
+
+		// Consider all configurations of depth 'depth-1', slice by slice. Within a slice, the
+		// static schedule assigns contiguous ranges to the threads (see doBreadthFirstSearch()).
+		std::atomic<uint64_t> solutionIndex(Config::NONE);
+		uint64_t solution = Config::NONE;
+		for (uint64_t first = 0; (first < length) && (solution == Config::NONE); first += SLICE)
+		{
+			uint64_t n = (length - first < SLICE) ? length - first : SLICE;
+			queue->read(first, n, confs, boxes);
+			// Determine the box positions of the slice, in parallel in groups of 1024
+#pragma omp parallel for schedule(static)
+			for (uint64_t j = 0; j < n; j += 1024)
+				Config::boxPositions(&confs[j], (n - j < 1024) ? n - j : 1024,
+									 &boxPos[j * Config::numBoxes()]);
+#pragma omp parallel for schedule(static)
+			for (uint64_t j = 0; j < n; j++)
+			{
+				// Stop if a solution has been found for an earlier configuration
+				if (first + j > solutionIndex.load(std::memory_order_relaxed))
+					continue;
+				expandConfig(queue, first + j, confs[j], &boxPos[j * Config::numBoxes()],
+							 boxes[j], depth > 1, solutionIndex, solution);
+			}
+		}
+
+		// If we found a solution: print it and terminate the search
+		if (solution != Config::NONE)
+		{
+			uint64_t len;
+			uint64_t *path = queue->getPath(solution, solutionIndex, &len);
+			printPath(path, len);
+			delete[] path;
+			queue->statistics();
+			break;
+		}
+
+		// Advance the queue for the next tree depth
+		depth++;
+		queue->pushDepth();
+		// Number of configurations in the next tree depth
+		length = queue->length();
+	}
+
+	// If the loop exits normally, there is no solution
+	if (length == 0)
+	{
+		std::cout << "No solution found!" << std::endl;
+		queue->statistics();
+	}
+	delete[] confs;
+	delete[] boxes;
+	delete[] boxPos;
+	delete queue;
+}
+
+/**
+ * Determine a path of 'depth' moves from the starting configuration 'start' to the
+ * configuration 'conf' with tree depth 'depth' in the two-bit map 'map' (see
+ * doTwoBitSearch()) and store it in path[0 ... depth]. The map only stores the depth modulo
+ * 3, so the value of depth k is shared by the depths k-3, k+3, ...; a successor or
+ * predecessor with that value may lie on a different layer than the path needs. Therefore,
+ * the path is determined in two passes:
+ * - Backwards, the set S[k] of configurations with the value of depth k that have a successor
+ *   in S[k+1] is determined for k = depth-1 ... 1, where S[depth] contains 'conf' only. Each
+ *   configuration in S[k] has a path of 'depth-k' moves to 'conf'.
+ * - Forwards, starting with 'start', the smallest successor in S[k] is chosen for k = 1 ...
+ *   depth. Such a successor exists, since each configuration in S[k-1] has one.
+ * The sets are sorted, so the path is the same for any number of threads.
+ */
+static void findTwoBitPath(StateMap *map, uint64_t start, uint64_t conf, uint64_t depth,
+						   uint64_t *path)
+{
+	uint64_t nBoxes = Config::numBoxes(); // Number of boxes
+	std::vector<std::vector<uint64_t>> sets(depth + 1);
+	sets[depth].push_back(conf);
+	for (uint64_t k = depth - 1; k > 0; k--)
+	{
+		std::vector<uint64_t> &next = sets[k + 1];
+		map->forEach(StateMap::code(k), [&](uint64_t p) {
+			Config c(p);
+			for (uint64_t box = 0; box < nBoxes; box++)
+			{
+				for (uint64_t dir = 0; dir < 4; dir++)
+				{
+					uint64_t s = c.getNextConfig(box, dir, NULL);
+					if ((s != Config::NONE) && std::binary_search(next.begin(), next.end(), s))
+					{
+#pragma omp critical
+						sets[k].push_back(p);
+						return;
+					}
+				}
+			}
+		});
+		std::sort(sets[k].begin(), sets[k].end());
+	}
+
+	path[0] = start;
+	for (uint64_t k = 1; k <= depth; k++)
+	{
+		Config c(path[k - 1]);
+		path[k] = Config::NONE;
+		for (uint64_t box = 0; box < nBoxes; box++)
+		{
+			for (uint64_t dir = 0; dir < 4; dir++)
+			{
+				uint64_t s = c.getNextConfig(box, dir, NULL);
+				if ((s != Config::NONE) && (s < path[k]) &&
+					std::binary_search(sets[k].begin(), sets[k].end(), s))
+					path[k] = s;
+			}
+		}
+		if (path[k] == Config::NONE)
+		{
+			std::cerr << "FATAL ERROR: No path to the solution found!" << std::endl;
+			exit(1);
+		}
+	}
+}
+
+/**
+ * Execute a breadth first search with a two-bit map over the whole space of configurations
+ * (see StateMap), instead of a queue. The map stores for each configuration found so far its
+ * tree depth modulo 3. The configurations of depth 'depth-1' are determined by scanning the
+ * map for the corresponding value; their successors that are not in the map yet are entered
+ * with the value of depth 'depth'. Since the value of depth 'depth-1' is also the value of
+ * depths 'depth-4', 'depth-7', ..., these configurations are expanded again; their successors
+ * are already in the map, so this costs time, but does not affect the result.
+ * The solution path is determined afterwards by walking back from the solution (see
+ * findTwoBitPath()).
+ */
+static void doTwoBitSearch(Config *conf)
+{
+	StateMap *map = new StateMap(Config::getNumConfigs());
+	uint64_t start = conf->getConfig();
+	map->mark(start, StateMap::code(0));
+
+	uint64_t nBoxes = Config::numBoxes(); // Number of boxes
+	uint64_t depth = 1;					  // Tree depth
+	uint64_t length = 1;				  // Number of configurations at depth 'depth-1'
+
+	// Pass through all layers of the tree with increasing depth until there are no
+	// configurations with this depth any more or a solution has been found.
+	while (length > 0)
+	{
+		// Print the progress
+		std::cerr << "depth " << depth << ": " << length << std::endl
+				  << std::flush;
+
+		// Expand all configurations with the value of depth 'depth-1'. The smallest solution
+		// configuration is kept, so the same solution is found for any number of threads.
+		std::atomic<uint64_t> count(0);
+		std::atomic<uint64_t> solution(Config::NONE);
+		uint64_t value = StateMap::code(depth);
+		map->forEach(StateMap::code(depth - 1), [&](uint64_t c) {
+			Config newConf(c);
+			uint64_t n = 0;
+			for (uint64_t box = 0; box < nBoxes; box++)
+			{
+				for (uint64_t dir = 0; dir < 4; dir++)
+				{
+					uint64_t s = newConf.getNextConfig(box, dir, NULL);
+					if ((s != Config::NONE) && map->mark(s, value))
+					{
+						n++;
+						uint64_t old = solution.load(std::memory_order_relaxed);
+						while (Config::isSolutionConf(s) && (s < old) &&
+							   !solution.compare_exchange_weak(old, s))
+							;
+					}
+				}
+			}
+			count.fetch_add(n, std::memory_order_relaxed);
+		});
+
+		// If we found a solution: determine the path, print it and terminate the search
+		if (solution != Config::NONE)
+		{
+			uint64_t *path = new uint64_t[depth + 1];
+			findTwoBitPath(map, start, solution, depth, path);
+			printPath(path, depth + 1);
+			delete[] path;
+			break;
+		}
+
+		// Number of configurations in the next tree depth
+		length = count;
+		depth++;
+	}
+
+	// If the loop exits normally, there is no solution
+	if (length == 0)
+		std::cout << "No solution found!" << std::endl;
+	std::cout << "Used " << map->memory() / 1024 << " KBytes for state map" << std::endl;
+	delete map;
+}
+
+/**
+ * One direction of the bidirectional search (see doBidirectionalSearch()): the set of
+ * visited configurations and the configurations of each tree depth (layer), sorted by
+ * configuration number.
+ */
+class SearchSide
+{
+  public:
+	VisitedSet *visited;
+	bool autoSelect;
+	std::vector<std::vector<uint64_t>> layers;
+
+	SearchSide(VisitedSet::Kind kind)
+	{
+		visited = VisitedSet::create(kind, Config::getNumConfigs());
+		autoSelect = (kind == VisitedSet::AUTO);
+	}
+
+	~SearchSide()
+	{
+		delete visited;
+	}
+};
+
+/**
+ * Expand the last layer of the search side 'side' by pushes ('forward') or by pulls (not
+ * 'forward'), and append the new configurations as the next layer. Returns the smallest new
+ * configuration that has already been visited by the 'other' side, or Config::NONE.
+ */
+static uint64_t expandLayer(SearchSide &side, SearchSide &other, bool forward)
+{
+	int nThreads = omp_get_max_threads();
+	std::vector<std::vector<uint64_t>> next(nThreads);
+	std::atomic<uint64_t> meet(Config::NONE);
+	const std::vector<uint64_t> &layer = side.layers.back();
+	uint64_t nBoxes = Config::numBoxes(); // Number of boxes
+
+#pragma omp parallel for schedule(dynamic, 1024)
+	for (uint64_t i = 0; i < layer.size(); i++)
+	{
+		std::vector<uint64_t> &confs = next[omp_get_thread_num()];
+		Config conf(layer[i]);
+		for (uint64_t box = 0; box < nBoxes; box++)
+		{
+			for (uint64_t dir = 0; dir < 4; dir++)
+			{
+				uint64_t c = forward ? conf.getNextConfig(box, dir, NULL)
+									 : conf.getPrevConfig(box, dir, NULL);
+				if ((c == Config::NONE) || !side.visited->testAndSet(c))
+					continue;
+				confs.push_back(c);
+				uint64_t old = meet.load(std::memory_order_relaxed);
+				while (other.visited->contains(c) && (c < old) &&
+					   !meet.compare_exchange_weak(old, c))
+					;
+			}
+		}
+	}
+
+	// Append the new layer, sorted, so that the path is the same for any number of threads
+	std::vector<uint64_t> newLayer;
+	for (int t = 0; t < nThreads; t++)
+		newLayer.insert(newLayer.end(), next[t].begin(), next[t].end());
+	std::sort(newLayer.begin(), newLayer.end());
+	side.layers.push_back(std::move(newLayer));
+
+	// Switch to a dense set as soon as it needs less memory (see BFSQueue::pushDepth())
+	if (side.autoSelect)
+	{
+		SparseVisitedSet *sparse = (SparseVisitedSet *)side.visited;
+		if (sparse->memory() > sparse->denseMemory())
+		{
+			side.visited = sparse->toDense();
+			delete sparse;
+			side.autoSelect = false;
+		}
+	}
+	return meet;
+}
+
+/**
+ * Return the smallest successor ('forward') or predecessor (not 'forward') of configuration
+ * 'conf' that is contained in the sorted 'layer'.
+ */
+static uint64_t findNeighbor(uint64_t conf, const std::vector<uint64_t> &layer, bool forward)
+{
+	Config c(conf);
+	uint64_t nBoxes = Config::numBoxes(); // Number of boxes
+	uint64_t result = Config::NONE;
+	for (uint64_t box = 0; box < nBoxes; box++)
+	{
+		for (uint64_t dir = 0; dir < 4; dir++)
+		{
+			uint64_t s = forward ? c.getNextConfig(box, dir, NULL)
+								 : c.getPrevConfig(box, dir, NULL);
+			if ((s != Config::NONE) && (s < result) &&
+				std::binary_search(layer.begin(), layer.end(), s))
+				result = s;
+		}
+	}
+	if (result == Config::NONE)
+	{
+		std::cerr << "FATAL ERROR: Invalid solution path!" << std::endl;
+		exit(1);
+	}
+	return result;
+}
+
+/**
+ * Execute a bidirectional breadth first search: a forward search from the starting
+ * configuration 'conf' by pushes, and a backward search from all solution configurations
+ * (the player may be in any connected component) by pulls (see Config::getPrevConfig()).
+ * Each side has its own set of visited configurations ('visitedKind'). In each step, the side
+ * with the smaller last layer is expanded by one tree depth, until a new configuration has
+ * been visited by the other side, too.
+ * If there is no such configuration before the expansion of layer f of the forward side (with
+ * b layers on the backward side), the shortest solution has at least f+b pushes. Each such
+ * configuration lies on a solution with f+b pushes, i.e., in the last layer of the other side,
+ * so the search can stop after this layer. The same holds for the backward side.
+ */
+static void doBidirectionalSearch(Config *conf, VisitedSet::Kind visitedKind)
+{
+	SearchSide fwd(visitedKind);
+	SearchSide bwd(visitedKind);
+	uint64_t start = conf->getConfig();
+	fwd.visited->testAndSet(start);
+	fwd.layers.push_back(std::vector<uint64_t>(1, start));
+	bwd.layers.push_back(std::vector<uint64_t>());
+	for (uint64_t comp = 0; Config::getSolutionConfig(comp) != Config::NONE; comp++)
+	{
+		bwd.visited->testAndSet(Config::getSolutionConfig(comp));
+		bwd.layers[0].push_back(Config::getSolutionConfig(comp));
+	}
+	uint64_t meet = Config::isSolutionConf(start) ? start : Config::NONE;
+
+	// Expand the smaller side until the sides meet or one of them has no configurations
+	// left.
+	while ((meet == Config::NONE) && !fwd.layers.back().empty() && !bwd.layers.back().empty())
+	{
+		bool forward = (fwd.layers.back().size() <= bwd.layers.back().size());
+		SearchSide &side = forward ? fwd : bwd;
+
+		// Print the progress
+		std::cerr << (forward ? "forward" : "backward") << " depth " << side.layers.size()
+				  << ": " << side.layers.back().size() << std::endl
+				  << std::flush;
+
+		meet = expandLayer(side, forward ? bwd : fwd, forward);
+	}
+
+	if (meet == Config::NONE)
+		std::cout << "No solution found!" << std::endl;
+	else
+	{
+		// The forward part of the path is determined backwards from the meeting
+		// configuration, using the predecessors in the forward layers; the backward part
+		// using the successors in the backward layers.
+		uint64_t f = fwd.layers.size() - 1;
+		uint64_t b = bwd.layers.size() - 1;
+		uint64_t *path = new uint64_t[f + b + 1];
+		path[f] = meet;
+		for (uint64_t k = f; k > 0; k--)
+			path[k - 1] = findNeighbor(path[k], fwd.layers[k - 1], false);
+		for (uint64_t j = 1; j <= b; j++)
+			path[f + j] = findNeighbor(path[f + j - 1], bwd.layers[b - j], true);
+		printPath(path, f + b + 1);
+		delete[] path;
+	}
+
+	uint64_t size = 0;
+	for (SearchSide *side : {&fwd, &bwd})
+	{
+		for (const std::vector<uint64_t> &layer : side->layers)
+			size += layer.capacity() * sizeof(uint64_t);
+	}
+	std::cout << "Used " << fwd.visited->memory() / 1024 << " KBytes for visited set (forward, "
+			  << fwd.visited->name() << ")" << std::endl;
+	std::cout << "Used " << bwd.visited->memory() / 1024 << " KBytes for visited set (backward, "
+			  << bwd.visited->name() << ")" << std::endl;
+	std::cout << "Used " << size / 1024 << " KBytes for layers" << std::endl;
+}
+
+/**
+ * Solve the starting configuration 'conf' with the distance database in file 'fname' (see
+ * DistanceDB), i.e., without a search.
+ */
+static void doDatabaseSearch(Config *conf, const char *fname)
+{
+	DistanceDB db(fname);
+	uint64_t length;
+	uint64_t *path = db.getPath(conf->getConfig(), &length);
+	if (path == NULL)
+		std::cout << "No solution found!" << std::endl;
+	printPath(path, length);
+	delete[] path;
 }
 
 /**
  * Global variable for depth first search
  * - best solution path found so far
  * - length of this path (= depth limit for the search)
+ * The path is only changed in the critical section 'path'. The length is read by all
+ * tasks without synchronization, hence it is atomic.
  */
 static uint64_t *path = NULL;
-static uint64_t path_len = 0;
+static std::atomic<uint64_t> path_len(0);
+
+/**
+ * Tree depth up to which the depth first search spawns a new task for each successor
+ * configuration. Below this depth, each task examines its subtree sequentially, so the
+ * overhead for creating tasks is only spent near the root, where the subtrees are large.
+ */
+static const uint64_t TASK_DEPTH = 4;
+
+/**
+ * Global variables for IDA* (see doHeuristicSearch()): if 'useHeuristic' is set, the depth
+ * first search also terminates a branch if the lower bound for the length of a solution path
+ * through the current configuration exceeds the maximum depth. 'nextBound' then receives the
+ * smallest such lower bound.
+ */
+static bool useHeuristic = false;
+static std::atomic<uint64_t> nextBound(Config::NONE);
 
 /**
  * Recursive depth first search. If 'conf' is a solution configuration, the
@@ -169,37 +680,63 @@ static uint64_t path_len = 0;
  * that stores the lowest tree depth found so far for each configuration.
  * It is used to avoid repeated examinations of the same configuration when
  * this is not necessary.
+ * Up to depth TASK_DEPTH, the successors are examined by new OpenMP tasks. Each task
+ * gets its own copy of the stack, so the tasks never access the same stack.
  */
 static void recDepthFirstSearch(Config *conf, uint64_t lastBox,
 								DFSStack *stack, DFSDepthMap *map)
 {
 	// Get the configuration number and push it on the stack.
 	uint64_t c = conf->getConfig();
-#pragma omp critical
 	stack->push(c);
 	uint64_t depth = stack->length();
 
-	// If we found a solution: remember the solution path (sequence of moves).
+	// If we found a solution: remember the solution path (sequence of moves), if it is
+	// the first one or shorter than the best one found so far by any task.
 	if (Config::isSolutionConf(c))
 	{
-		delete[] path;
-		path = stack->getPath(&path_len);
-		std::cout << "Found solution: " << (path_len - 1) << " pushes" << std::endl;
+#pragma omp critical(path)
+		if ((path == NULL) || (depth < path_len.load()))
+		{
+			uint64_t len;
+			delete[] path;
+			path = stack->getPath(&len);
+			path_len.store(len);
+			std::cout << "Found solution: " << (len - 1) << " pushes" << std::endl;
+		}
 		stack->pop();
 		return;
 	}
 
+	// For IDA*: terminate the branch if it cannot contain a solution within the maximum
+	// depth, according to the lower bound for the remaining number of pushes.
+	if (useHeuristic)
+	{
+		uint64_t h = Heuristic::estimate(c);
+		uint64_t bound = (h == Config::NONE) ? Config::NONE : depth + h;
+		if (bound > path_len.load(std::memory_order_relaxed))
+		{
+			uint64_t old = nextBound.load(std::memory_order_relaxed);
+			while ((bound < old) && !nextBound.compare_exchange_weak(old, bound))
+				;
+			stack->pop();
+			return;
+		}
+	}
+
 	// If the depth is larger than the length of the best solution path found so far:
 	// Terminate the examination of this branch (it cannot contain a better solution
 	// any more).
-	if (depth >= path_len)
+	if (depth >= path_len.load(std::memory_order_relaxed))
 	{
 		stack->pop();
 		return;
 	}
 
+	// If the last push must be continued through a tunnel, this is the only push considered
+	uint64_t tunnelDir = (depth > 1) ? conf->getTunnelDir(lastBox) : Config::NONE;
+
 	// Consider all boxes, starting with the box that was moved last
-	bool Flag_ConfigAdded = false;
 	uint64_t nBoxes = Config::numBoxes();
 	for (uint64_t b = 0; b < nBoxes; b++)
 	{
@@ -207,6 +744,8 @@ static void recDepthFirstSearch(Config *conf, uint64_t lastBox,
 		// Consider all directions of movement
 		for (uint64_t dir = 0; dir < 4; dir++)
 		{
+			if ((tunnelDir != Config::NONE) && ((box != lastBox) || (dir != tunnelDir)))
+				continue;
 			uint64_t newBox;
 			// Determine the configuration that results from moving box
 			// 'box' in direction 'dir'.
@@ -214,23 +753,31 @@ static void recDepthFirstSearch(Config *conf, uint64_t lastBox,
 
 			// If the move is valid, check whether the resuling configuration has
 			// already been found at the same or a smaller depth. If not, store
-			// the new depth for this configuration.
+			// the new depth for this configuration. Configurations restricted by the
+			// tunnel macro are not stored (see Config::isTunnelPush()).
 			if (c != Config::NONE)
 			{
-				// Recursively continue the search on a copy of the configuration		
-#pragma omp critical
-				Flag_ConfigAdded = map->lookup_and_set(c, depth + 1);
-				if (Flag_ConfigAdded)
+				if (!conf->isTunnelPush(box, dir, c, newBox)
+					&& !map->lookup_and_set(omp_get_thread_num(), c, depth + 1))
+					continue;
+
+				// Recursively continue the search on a copy of the configuration, near the
+				// root of the tree in a new task with a copy of the stack.
+				if (depth < TASK_DEPTH)
 				{
-					DFSStack *NewStack = new DFSStack(*stack);
-                    #pragma omp task shared(map)
+					DFSStack *newStack = new DFSStack(*stack);
+#pragma omp task firstprivate(c, newBox, newStack) shared(map)
 					{
-						
 						Config next(c);
-						recDepthFirstSearch(&next, box, stack, map);
-						delete NewStack;
+						recDepthFirstSearch(&next, newBox, newStack, map);
+						delete newStack;
 					}
 				}
+				else
+				{
+					Config next(c);
+					recDepthFirstSearch(&next, newBox, stack, map);
+				}
 			}
 		}
 	}
@@ -239,52 +786,207 @@ static void recDepthFirstSearch(Config *conf, uint64_t lastBox,
 
 /**
  * Wrapper procedure for recursive depth first search. The search starts at the
- * starting configuration 'conf' and continues up to the maximum depth 'maxDepth'.
+ * starting configuration 'conf' and continues up to the maximum depth 'maxDepth'. The
+ * depths of the examined configurations are stored with the backend 'visitedKind' (see
+ * DFSDepthMap).
  */
-static void doDepthFirstSearch(Config *conf, uint64_t maxDepth)
+static void doDepthFirstSearch(Config *conf, uint64_t maxDepth, VisitedSet::Kind visitedKind)
 {
 	DFSStack stack(maxDepth);
-	DFSDepthMap map(Config::getNumConfigs(), maxDepth);
-	map.lookup_and_set(conf->getConfig(), 1);
+	DFSDepthMap *map = DFSDepthMap::create(visitedKind, Config::getNumConfigs(), maxDepth,
+										   omp_get_max_threads());
+	map->lookup_and_set(0, conf->getConfig(), 1);
 	path_len = maxDepth;
 
-	#pragma omp parallel
-	#pragma omp single nowait
-	recDepthFirstSearch(conf, 0, &stack, &map);
-	map.statistics(path_len);
-	printPath(path, path_len);
+	// One thread starts the search, the tasks are executed by all threads of the team.
+	// The implicit barrier at the end of the parallel region waits for all tasks.
+#pragma omp parallel
+#pragma omp single nowait
+	recDepthFirstSearch(conf, 0, &stack, map);
+	map->statistics(path_len);
+	printPath(path, (path != NULL) ? path_len.load() : 0);
+	delete[] path;
+	delete map;
+}
+
+/**
+ * Iterative deepening A* (IDA*): a sequence of depth first searches (see doDepthFirstSearch())
+ * with increasing maximum depth, starting with the lower bound for the number of pushes of
+ * the starting configuration 'conf' (see Heuristic). Branches whose lower bound exceeds the
+ * maximum depth are terminated; the next maximum depth is the smallest lower bound of these
+ * branches. The lower bound never exceeds the actual number of pushes, so the first solution
+ * is push-optimal. The DFSDepthMap of each iteration serves as transposition table.
+ * Heuristic must have been initialized, and 'useHeuristic' must be set. 'visitedKind'
+ * selects the backend of the DFSDepthMap.
+ */
+static void doHeuristicSearch(Config *conf, VisitedSet::Kind visitedKind)
+{
+	uint64_t h = Heuristic::estimate(conf->getConfig());
+	uint64_t maxDepth = (h == Config::NONE) ? Config::NONE : h + 1;
+	uint64_t total = 0;
+
+	// maxDepth is the maximum number of configurations in the path (i.e., pushes + 1)
+	while (maxDepth != Config::NONE)
+	{
+		DFSStack stack(maxDepth);
+		DFSDepthMap *map = DFSDepthMap::create(visitedKind, Config::getNumConfigs(), maxDepth,
+											   omp_get_max_threads());
+		map->lookup_and_set(0, conf->getConfig(), 1);
+		path_len = maxDepth;
+		nextBound = Config::NONE;
+
+#pragma omp parallel
+#pragma omp single nowait
+		recDepthFirstSearch(conf, 0, &stack, map);
+
+		// Print the progress
+		std::cerr << "bound " << (maxDepth - 1) << ": " << map->size() << std::endl
+				  << std::flush;
+		total += map->size();
+		if (path != NULL)
+		{
+			map->statistics(path_len);
+			delete map;
+			break;
+		}
+		delete map;
+		maxDepth = nextBound;
+	}
+
+	std::cout << "Examined " << total << " configurations" << std::endl;
+	if (path == NULL)
+		std::cout << "No solution found!" << std::endl;
+	printPath(path, (path != NULL) ? path_len.load() : 0);
 	delete[] path;
 }
 
+/**
+ * Print the invocation of the program and terminate.
+ */
+static void usage()
+{
+	std::cerr << "Usage: sokoban [-v dense|sparse|auto] [-m bfs|external|twobit|bidir|ida]"
+			  << " [-M <megabytes>] [-p <size>]"
+			  << " [-b <db-file>|-d <db-file>] <level-file> [<max-depth>]"
+			  << std::endl;
+	exit(1);
+}
+
 /**
  * Main program. Invocation:
- *    sokoban <level-file> [<max-depth>]
+ *    sokoban [-v dense|sparse|auto] [-m bfs|external|twobit|bidir|ida] [-M <megabytes>]
+ *            [-p <size>] [-b <db-file>|-d <db-file>] <level-file> [<max-depth>]
  * If 'max-depth' is give, a depth first search up to a maximum depth of 'max-depth'
  * is performed, otherwise a breadth first search.
+ * Option -v selects the implementation of the set of visited configurations for the
+ * breadth first search (see VisitedSet) and of the depth map of the depth first search
+ * and of 'ida' (see DFSDepthMap); the default is 'auto'.
+ * Option -m selects the breadth first search: 'bfs' (the default) keeps the visited
+ * configurations in main memory, 'external' uses delayed duplicate detection in temporary
+ * files (see ExternalQueue) with at most 'megabytes' MB of main memory for the run buffers
+ * (option -M, default 256), 'twobit' uses a map with 2 bits per configuration instead of
+ * a queue (see doTwoBitSearch()), 'bidir' searches forward from the starting configuration
+ * and backward from the solution at the same time (see doBidirectionalSearch()), 'ida' is an
+ * informed search with a lower bound for the number of pushes (see doHeuristicSearch()).
+ * Option -b builds the database with the distances to the solution for all configurations of
+ * the level and stores it in 'db-file' (see DistanceDB). Option -d solves the level with such
+ * a database instead of a search; the database may have been built for another level with the
+ * same playing field.
+ * Option -p uses pattern databases for groups of 'size' targets (see PatternDB) to improve the
+ * lower bound of 'ida', and to terminate branches of the depth first search whose lower bound
+ * exceeds 'max-depth'. The databases are stored next to the level file and reused.
  */
 int main(int argc, char **argv)
 {
 	std::cout << "sizeof(uint64_t): " << sizeof(uint64_t) << std::endl;
-	if ((argc < 2) || (argc > 3))
+
+	// Parse the options
+	VisitedSet::Kind visitedKind = VisitedSet::AUTO;
+	std::string mode = "bfs";
+	uint64_t memory = 256;
+	const char *buildFile = NULL;
+	const char *dbFile = NULL;
+	uint64_t patternSize = 0;
+	int arg = 1;
+	while ((arg < argc) && (argv[arg][0] == '-'))
 	{
-		std::cerr << "Usage: sokoban <level-file> [<max-depth>]" << std::endl;
-		exit(1);
+		std::string option = argv[arg];
+		if (arg + 1 >= argc)
+			usage();
+		if (option == "-v")
+			visitedKind = VisitedSet::parseKind(argv[arg + 1]);
+		else if (option == "-m")
+			mode = argv[arg + 1];
+		else if (option == "-M")
+			memory = atoi(argv[arg + 1]);
+		else if (option == "-b")
+			buildFile = argv[arg + 1];
+		else if (option == "-d")
+			dbFile = argv[arg + 1];
+		else if (option == "-p")
+			patternSize = atoi(argv[arg + 1]);
+		else
+			usage();
+		arg += 2;
 	}
+	if ((mode != "bfs") && (mode != "external") && (mode != "twobit") &&
+		(mode != "bidir") && (mode != "ida"))
+		usage();
+	if ((argc - arg < 1) || (argc - arg > 2))
+		usage();
 
 	// Initialize the configuration with the starting configuration (level) from the file
-	Config *conf = Config::init(argv[1]);
+	Config *conf = Config::init(argv[arg]);
 
 	auto ta = std::chrono::high_resolution_clock::now();
-	if (argc > 2)
+
+	// Initialize the lower bound for IDA* and for the depth first search with pattern databases
+	if ((mode == "ida") || ((patternSize > 0) && (argc - arg > 1)))
+	{
+		Heuristic::init(patternSize, argv[arg]);
+		useHeuristic = true;
+	}
+
+	if (buildFile != NULL)
+	{
+		// build the distance database
+		DistanceDB::build(buildFile);
+	}
+	else if (dbFile != NULL)
+	{
+		// solve with the distance database
+		doDatabaseSearch(conf, dbFile);
+	}
+	else if (argc - arg > 1)
 	{
 		// depth first search
-		uint64_t maxDepth = atoi(argv[2]);
-		doDepthFirstSearch(conf, maxDepth + 1);
+		uint64_t maxDepth = atoi(argv[arg + 1]);
+		doDepthFirstSearch(conf, maxDepth + 1, visitedKind);
+	}
+	else if (mode == "ida")
+	{
+		// iterative deepening A*
+		doHeuristicSearch(conf, visitedKind);
+	}
+	else if (mode == "bidir")
+	{
+		// bidirectional breadth first search
+		doBidirectionalSearch(conf, visitedKind);
+	}
+	else if (mode == "twobit")
+	{
+		// breadth first search with a two-bit map
+		doTwoBitSearch(conf);
+	}
+	else if (mode == "external")
+	{
+		// breadth first search in external memory
+		doExternalSearch(conf, memory << 20);
 	}
 	else
 	{
 		// breadth first search
-		doBreadthFirstSearch(conf);
+		doBreadthFirstSearch(conf, visitedKind);
 	}
 	auto te = std::chrono::high_resolution_clock::now();
 
@@ -0,0 +1,71 @@
+#include "statemap.h"
+
+/**
+ * Map with 2 bits per configuration number for the two-bit breadth first search. Each cell
+ * contains 0 if the configuration has not been found yet, otherwise 1 + (depth mod 3).
+ */
+
+
+/**
+ * Constructor: Create a map for configuration numbers between 0 and numConf-1.
+ */
+StateMap::StateMap(uint64_t numConf)
+{
+	// Allocate the first-level array and initialize it with NULL
+	numConfigs = numConf;
+	map_length = index1(numConf-1) + 1;
+	map = new std::atomic<std::atomic<uint64_t> *>[map_length]();
+}
+
+/**
+ * Destructur: deallocate memory.
+ */
+StateMap::~StateMap()
+{
+	for (uint64_t i=0; i<map_length; i++) {
+		delete[] map[i];
+	}
+	delete[] map;
+}
+
+/**
+ * Set the cell of configuration 'conf' to 'value', if it is 0. Returns 'true' if the cell
+ * has been set by this call. The method is thread-safe.
+ */
+bool StateMap::mark(uint64_t conf, uint64_t value)
+{
+	uint64_t i1 = index1(conf);
+	uint64_t i2 = index2(conf);
+	uint64_t s = shift(conf);
+
+	// If necessary, allocate an array at the second level and initialize it with 0. If
+	// several threads try to install a block at the same time, only one of them succeeds;
+	// the others delete their block and use the installed one.
+	std::atomic<uint64_t> * block = map[i1].load(std::memory_order_acquire);
+	if (block == NULL) {
+		std::atomic<uint64_t> * newBlock = new std::atomic<uint64_t>[BLOCKSIZE]();
+		if (map[i1].compare_exchange_strong(block, newBlock, std::memory_order_acq_rel))
+			block = newBlock;
+		else
+			delete[] newBlock;
+	}
+
+	// Quick check without a write access. Otherwise set the cell; since all threads write the
+	// same value into a cell, the cell has been set by this call if it was 0 before.
+	if (((block[i2].load(std::memory_order_relaxed) >> s) & 3) != 0)
+		return false;
+	return ((block[i2].fetch_or(value << s, std::memory_order_relaxed) >> s) & 3) == 0;
+}
+
+/**
+ * Return the number of bytes of main memory used by the map.
+ */
+uint64_t StateMap::memory()
+{
+	uint64_t size = map_length*sizeof(uint64_t *);
+	for (uint64_t i=0; i<map_length; i++) {
+		if (map[i] != NULL)
+			size += BLOCKSIZE*sizeof(uint64_t);
+	}
+	return size;
+}
@@ -0,0 +1,109 @@
+#include <cstdint>
+#include <atomic>
+#include <cstddef>
+
+/**
+ * Map with 2 bits per configuration number for the two-bit breadth first search. Each cell
+ * contains 0 if the configuration has not been found yet, otherwise 1 + (depth mod 3), where
+ * 'depth' is the tree depth of the configuration. Since the configurations are numbered
+ * perfectly (see Converter), the map covers the whole space of configurations, and a tree depth
+ * is determined by scanning the map for the cells with the corresponding value, without
+ * any queue.
+ */
+class StateMap
+{
+ private:
+	// The map is implemented as a two-level array (i.e., an array of arrays), where the second
+	// level is only allocated as required (analogous to two-level page tables in operating
+	// systems). The arrays of the second level have 2^16 64-bit words with 32 cells each.
+	// Cells are set with an atomic fetch-or, so concurrent insertions of the same
+	// configuration are detected by exactly one thread.
+	std::atomic<std::atomic<uint64_t> *> * map;
+
+	// Number of entries in the first-level array
+	uint64_t map_length;
+
+	// Number of configurations
+	uint64_t numConfigs;
+
+	static const uint64_t BLOCKBITS = 16;                 // 16 Bit, arrays with 65536 words
+	static const uint64_t BLOCKSIZE = (1<<BLOCKBITS);     // Block size for allocation: 2^16
+	static const uint64_t BLOCKMASK = ((1<<BLOCKBITS)-1); // Bit mask where the last 16 bits
+	                                                          // are set
+	static const uint64_t CELLBITS = 5;                   // 32 cells per word
+
+	inline uint64_t index1(uint64_t i) { return i >> (CELLBITS + BLOCKBITS); }
+	inline uint64_t index2(uint64_t i) { return (i >> CELLBITS) & BLOCKMASK; }
+	inline uint64_t shift(uint64_t i)  { return 2 * (i & ((1<<CELLBITS)-1)); }
+
+	// The lower bit of each cell
+	static const uint64_t LOWBITS = 0x5555555555555555ULL;
+
+ public:
+	/**
+	 * Value of a cell for a configuration of tree depth 'depth'.
+	 */
+	static inline uint64_t code(uint64_t depth) { return 1 + depth % 3; }
+
+	/**
+	 * Constructor: Create a map for configuration numbers between 0 and numConf-1.
+	 */
+	StateMap(uint64_t numConf);
+
+	/**
+	 * Destructur: deallocate memory.
+	 */
+	~StateMap();
+
+	/**
+	 * Return the value of the cell of configuration 'conf'.
+	 */
+	inline uint64_t get(uint64_t conf)
+	{
+		std::atomic<uint64_t> * block = map[index1(conf)].load(std::memory_order_relaxed);
+		if (block == NULL)
+			return 0;
+		return (block[index2(conf)].load(std::memory_order_relaxed) >> shift(conf)) & 3;
+	}
+
+	/**
+	 * Set the cell of configuration 'conf' to 'value', if it is 0. Returns 'true' if the cell
+	 * has been set by this call. The method is thread-safe.
+	 */
+	bool mark(uint64_t conf, uint64_t value);
+
+	/**
+	 * Call f(conf) for each configuration whose cell contains 'value'. The map is scanned in
+	 * parallel by all threads; f must be thread-safe. The cells may be modified by f, as long
+	 * as no cell is set to 'value'.
+	 */
+	template <class F>
+	void forEach(uint64_t value, F f)
+	{
+		uint64_t pattern = value * LOWBITS;
+#pragma omp parallel for schedule(dynamic)
+		for (uint64_t i1 = 0; i1 < map_length; i1++) {
+			std::atomic<uint64_t> * block = map[i1].load(std::memory_order_relaxed);
+			if (block == NULL)
+				continue;
+			for (uint64_t i2 = 0; i2 < BLOCKSIZE; i2++) {
+				// A cell contains 'value' if both of its bits are equal to the pattern.
+				// 'match' contains the lower bit of these cells.
+				uint64_t x = block[i2].load(std::memory_order_relaxed) ^ pattern;
+				uint64_t match = ~(x | (x >> 1)) & LOWBITS;
+				while (match != 0) {
+					uint64_t conf = (((i1 << BLOCKBITS) + i2) << CELLBITS)
+									+ __builtin_ctzll(match) / 2;
+					match &= match - 1;
+					if (conf < numConfigs)
+						f(conf);
+				}
+			}
+		}
+	}
+
+	/**
+	 * Return the number of bytes of main memory used by the map.
+	 */
+	uint64_t memory();
+};
@@ -0,0 +1,284 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <iostream>
+
+#include "visitedset.h"
+
+/**
+ * Set of configuration numbers that have already been visited by the search. There are two
+ * implementations (backends), DenseVisitedSet and SparseVisitedSet.
+ */
+
+
+/**
+ * Create an (empty) set for configuration numbers between 0 and numConf-1 using the
+ * backend 'kind' (SPARSE for AUTO).
+ */
+VisitedSet * VisitedSet::create(Kind kind, uint64_t numConf)
+{
+	if (kind == DENSE)
+		return new DenseVisitedSet(numConf);
+	return new SparseVisitedSet(numConf);
+}
+
+/**
+ * Return the backend with the name 'name' ("dense", "sparse", or "auto"). Terminates the
+ * program, if there is no such backend.
+ */
+VisitedSet::Kind VisitedSet::parseKind(const char * name)
+{
+	if (strcmp(name, "dense") == 0)
+		return DENSE;
+	if (strcmp(name, "sparse") == 0)
+		return SPARSE;
+	if (strcmp(name, "auto") == 0)
+		return AUTO;
+	std::cerr << "Unknown visited set '" << name << "' (dense, sparse, or auto)" << std::endl;
+	exit(1);
+}
+
+// =========================================================
+
+/**
+ * Constructor: Create a bit set for configuration numbers between 0 and numConf-1.
+ */
+DenseVisitedSet::DenseVisitedSet(uint64_t numConf)
+{
+	// Allocate the first-level array and initialize it with NULL
+	bitset_length = bsIndex1(numConf-1) + 1;
+	bitset = new std::atomic<std::atomic<uint64_t> *>[bitset_length]();
+}
+
+/**
+ * Destructur: deallocate memory.
+ */
+DenseVisitedSet::~DenseVisitedSet()
+{
+	for (uint64_t i=0; i<bitset_length; i++) {
+		delete[] bitset[i];
+	}
+	delete[] bitset;
+}
+
+/**
+ * Return 'true' if the configuration 'conf' is contained in the set.
+ */
+bool DenseVisitedSet::contains(uint64_t conf)
+{
+	std::atomic<uint64_t> * block = bitset[bsIndex1(conf)].load(std::memory_order_relaxed);
+	return (block != NULL)
+		&& ((block[bsIndex2(conf)].load(std::memory_order_relaxed)
+			 & ((uint64_t)1 << bsBitPos(conf))) != 0);
+}
+
+/**
+ * Enter the configuration 'conf' into the set. Returns 'false' if it was already
+ * contained. The method is thread-safe.
+ */
+bool DenseVisitedSet::testAndSet(uint64_t conf)
+{
+	uint64_t bitmask = (uint64_t)1 << bsBitPos(conf);
+	uint64_t i1 = bsIndex1(conf);
+	uint64_t i2 = bsIndex2(conf);
+
+	// If necessary, allocate an array at the second level and initialize it with 0. If
+	// several threads try to install a block at the same time, only one of them succeeds;
+	// the others delete their block and use the installed one.
+	std::atomic<uint64_t> * block = bitset[i1].load(std::memory_order_acquire);
+	if (block == NULL) {
+		std::atomic<uint64_t> * newBlock = new std::atomic<uint64_t>[BLOCKSIZE]();
+		if (bitset[i1].compare_exchange_strong(block, newBlock, std::memory_order_acq_rel))
+			block = newBlock;
+		else
+			delete[] newBlock;
+	}
+
+	// Quick check without a write access: if the configuration is in the bit set, we are done.
+	// This avoids making the cache line exclusive for the (frequent) duplicates.
+	if ((block[i2].load(std::memory_order_relaxed) & bitmask) != 0)
+		return false;
+
+	// Add the configuration to the bit set. If another thread has set the bit in the meantime,
+	// that thread is responsible for the configuration.
+	return (block[i2].fetch_or(bitmask, std::memory_order_relaxed) & bitmask) == 0;
+}
+
+/**
+ * Prefetch the memory accessed by contains(conf) and testAndSet(conf) into the cache.
+ */
+void DenseVisitedSet::prefetch(uint64_t conf)
+{
+	std::atomic<uint64_t> * block = bitset[bsIndex1(conf)].load(std::memory_order_relaxed);
+	if (block != NULL)
+		__builtin_prefetch(&block[bsIndex2(conf)]);
+}
+
+/**
+ * Return the number of bytes of main memory used by the set.
+ */
+uint64_t DenseVisitedSet::memory()
+{
+	uint64_t nBlocks = 0;
+	for (uint64_t i=0; i<bitset_length; i++) {
+		if (bitset[i] != NULL)
+			nBlocks++;
+	}
+	return bitset_length*sizeof(uint64_t *) + nBlocks*BLOCKSIZE*sizeof(uint64_t);
+}
+
+/**
+ * Return the number of bytes used by a set for 'numConf' configurations, in which
+ * 'nBlocks' second-level arrays have been allocated.
+ */
+uint64_t DenseVisitedSet::memory(uint64_t numConf, uint64_t nBlocks)
+{
+	return (bsIndex1(numConf-1) + 1)*sizeof(uint64_t *) + nBlocks*BLOCKSIZE*sizeof(uint64_t);
+}
+
+// =========================================================
+
+/**
+ * Constructor: Create an empty hash table for configuration numbers between 0 and
+ * numConf-1.
+ */
+SparseVisitedSet::SparseVisitedSet(uint64_t numConf)
+{
+	numConfigs = numConf;
+	blocks = new std::atomic<uint64_t>[DenseVisitedSet::bsIndex1(numConf-1) / 64 + 1]();
+	nBlocks = 0;
+	shards = new Shard[SHARDS];
+	for (uint64_t s=0; s<SHARDS; s++) {
+		shards[s].bits = __builtin_ctzll(INITIAL_CAPACITY);
+		shards[s].slots = new uint64_t[INITIAL_CAPACITY];
+		memset(shards[s].slots, 0xff, INITIAL_CAPACITY * sizeof(uint64_t));
+		shards[s].count = 0;
+	}
+}
+
+/**
+ * Destructur: deallocate memory.
+ */
+SparseVisitedSet::~SparseVisitedSet()
+{
+	for (uint64_t s=0; s<SHARDS; s++)
+		delete[] shards[s].slots;
+	delete[] shards;
+	delete[] blocks;
+}
+
+// Insert 'conf' into the slots of 'shard' (no check for duplicates, no locking)
+void SparseVisitedSet::insert(Shard & shard, uint64_t conf)
+{
+	uint64_t mask = ((uint64_t)1 << shard.bits) - 1;
+	uint64_t i = slotOf(hash(conf), shard.bits);
+	while (shard.slots[i] != EMPTY)
+		i = (i + 1) & mask;
+	shard.slots[i] = conf;
+	shard.count++;
+}
+
+/**
+ * Return 'true' if the configuration 'conf' is contained in the set.
+ */
+bool SparseVisitedSet::contains(uint64_t conf)
+{
+	uint64_t h = hash(conf);
+	Shard & shard = shards[shardOf(h)];
+	uint64_t mask = ((uint64_t)1 << shard.bits) - 1;
+	for (uint64_t i = slotOf(h, shard.bits); ; i = (i + 1) & mask) {
+		if (shard.slots[i] == conf)
+			return true;
+		if (shard.slots[i] == EMPTY)
+			return false;
+	}
+}
+
+/**
+ * Enter the configuration 'conf' into the set. Returns 'false' if it was already
+ * contained. The method is thread-safe.
+ */
+bool SparseVisitedSet::testAndSet(uint64_t conf)
+{
+	uint64_t h = hash(conf);
+	Shard & shard = shards[shardOf(h)];
+	std::lock_guard<std::mutex> lock(shard.lock);
+
+	uint64_t mask = ((uint64_t)1 << shard.bits) - 1;
+	uint64_t i = slotOf(h, shard.bits);
+	for (; shard.slots[i] != EMPTY; i = (i + 1) & mask) {
+		if (shard.slots[i] == conf)
+			return false;
+	}
+	shard.slots[i] = conf;
+	shard.count++;
+
+	// Count the second-level arrays of a dense set
+	uint64_t b = DenseVisitedSet::bsIndex1(conf);
+	uint64_t bit = (uint64_t)1 << (b % 64);
+	if ((blocks[b / 64].fetch_or(bit, std::memory_order_relaxed) & bit) == 0)
+		nBlocks.fetch_add(1, std::memory_order_relaxed);
+
+	// If the shard is half full: double its size and rehash the entries
+	if (2 * shard.count > mask + 1) {
+		uint64_t * old = shard.slots;
+		uint64_t oldCapacity = mask + 1;
+		shard.bits++;
+		shard.slots = new uint64_t[2 * oldCapacity];
+		memset(shard.slots, 0xff, 2 * oldCapacity * sizeof(uint64_t));
+		shard.count = 0;
+		for (uint64_t j=0; j<oldCapacity; j++) {
+			if (old[j] != EMPTY)
+				insert(shard, old[j]);
+		}
+		delete[] old;
+	}
+	return true;
+}
+
+/**
+ * Prefetch the memory accessed by contains(conf) and testAndSet(conf) into the cache.
+ */
+void SparseVisitedSet::prefetch(uint64_t conf)
+{
+	uint64_t h = hash(conf);
+	Shard & shard = shards[shardOf(h)];
+	__builtin_prefetch(&shard.slots[slotOf(h, shard.bits)]);
+}
+
+/**
+ * Return the number of bytes of main memory used by the set.
+ */
+uint64_t SparseVisitedSet::memory()
+{
+	uint64_t size = SHARDS*sizeof(Shard);
+	for (uint64_t s=0; s<SHARDS; s++)
+		size += ((uint64_t)1 << shards[s].bits) * sizeof(uint64_t);
+	return size;
+}
+
+/**
+ * Return the number of bytes a dense set with the same contents would use.
+ */
+uint64_t SparseVisitedSet::denseMemory()
+{
+	return DenseVisitedSet::memory(numConfigs, nBlocks);
+}
+
+/**
+ * Create a dense set with the same contents. The method must not be called concurrently
+ * with testAndSet().
+ */
+DenseVisitedSet * SparseVisitedSet::toDense()
+{
+	DenseVisitedSet * dense = new DenseVisitedSet(numConfigs);
+#pragma omp parallel for schedule(dynamic)
+	for (uint64_t s=0; s<SHARDS; s++) {
+		uint64_t capacity = (uint64_t)1 << shards[s].bits;
+		for (uint64_t j=0; j<capacity; j++) {
+			if (shards[s].slots[j] != EMPTY)
+				dense->testAndSet(shards[s].slots[j]);
+		}
+	}
+	return dense;
+}
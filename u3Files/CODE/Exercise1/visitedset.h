@@ -0,0 +1,211 @@
+#ifndef VISITEDSET_H
+#define VISITEDSET_H
+
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+
+/**
+ * Set of configuration numbers that have already been visited by the search. There are two
+ * implementations (backends):
+ * - DenseVisitedSet: a bit set with one bit per configuration number. It needs 1 bit per
+ *   possible configuration (in the allocated blocks), independent of the number of visited
+ *   configurations.
+ * - SparseVisitedSet: a hash table of the visited configuration numbers. It needs 16 bytes
+ *   per visited configuration on average, independent of the number of possible
+ *   configurations.
+ * Thus, the dense set is better if a significant fraction of the configurations is visited,
+ * and the sparse set if the space of configurations is huge and only sparsely visited.
+ * Both backends allow concurrent calls of testAndSet(), and concurrent calls of contains().
+ * contains() must not be called concurrently with testAndSet().
+ */
+class VisitedSet
+{
+ public:
+	/**
+	 * Kind of backend. AUTO starts with a sparse set and switches to a dense set as soon
+	 * as the dense set would need less memory (see BFSQueue::pushDepth()).
+	 */
+	enum Kind { DENSE, SPARSE, AUTO };
+
+	/**
+	 * Create an (empty) set for configuration numbers between 0 and numConf-1 using the
+	 * backend 'kind' (SPARSE for AUTO).
+	 */
+	static VisitedSet * create(Kind kind, uint64_t numConf);
+
+	/**
+	 * Return the backend with the name 'name' ("dense", "sparse", or "auto"). Terminates the
+	 * program, if there is no such backend.
+	 */
+	static Kind parseKind(const char * name);
+
+	virtual ~VisitedSet() {}
+
+	/**
+	 * Return 'true' if the configuration 'conf' is contained in the set.
+	 */
+	virtual bool contains(uint64_t conf) = 0;
+
+	/**
+	 * Enter the configuration 'conf' into the set. Returns 'false' if it was already
+	 * contained. The method is thread-safe.
+	 */
+	virtual bool testAndSet(uint64_t conf) = 0;
+
+	/**
+	 * Prefetch the memory accessed by contains(conf) and testAndSet(conf) into the cache.
+	 */
+	virtual void prefetch(uint64_t conf) = 0;
+
+	/**
+	 * Return the number of bytes of main memory used by the set.
+	 */
+	virtual uint64_t memory() = 0;
+
+	/**
+	 * Return the name of the backend.
+	 */
+	virtual const char * name() = 0;
+
+};
+
+/**
+ * Bit set with one bit per configuration number.
+ */
+class DenseVisitedSet : public VisitedSet
+{
+ private:
+	// The bit set is dynamically allocated block by block, and only when necessary. For this
+	// purpose a two-level array (i.e., an array of arrays) is used instead of a simple array.
+	// The second level is only allocated as required (analogous to two-level page tables in
+	// operating systems). The arrays of the second level have 2^16 64-bit words each.
+	// Bits are set with an atomic fetch-or, so concurrent insertions of the same
+	// configuration are detected by exactly one thread.
+	std::atomic<std::atomic<uint64_t> *> * bitset;
+
+	// Number of entries in the first-level array
+	uint64_t bitset_length;
+
+	static const uint64_t BLOCKBITS = 16;                 // 16 Bit, arrays with 65536 words
+	static const uint64_t BLOCKSIZE = (1<<BLOCKBITS);     // Block size for allocation: 2^16
+	static const uint64_t BLOCKMASK = ((1<<BLOCKBITS)-1); // Bit mask where the last 16 bits
+	                                                          // are set
+
+	// For a given configuration number, bsBitPos returns the bit position within a word.
+
+	static const uint64_t WORDBITS = 6;                 // 6 Bit = 0..63, bits in one word
+	static const uint64_t WORDMASK = ((1<<WORDBITS)-1); // Bit mask where the last 6 Bits
+	                                                        // are set
+
+	inline uint64_t bsIndex2(uint64_t i) { return (i >> WORDBITS) & BLOCKMASK; }
+	inline uint64_t bsBitPos(uint64_t i) { return i & WORDMASK; }
+
+ public:
+	/**
+	 * Constructor: Create a bit set for configuration numbers between 0 and numConf-1.
+	 */
+	DenseVisitedSet(uint64_t numConf);
+
+	/**
+	 * Destructur: deallocate memory.
+	 */
+	~DenseVisitedSet();
+
+	/**
+	 * Return the index of the second-level array containing the bit of configuration 'i'.
+	 */
+	static inline uint64_t bsIndex1(uint64_t i) { return i >> (WORDBITS + BLOCKBITS); }
+
+	/**
+	 * Return the number of bytes used by a set for 'numConf' configurations, in which
+	 * 'nBlocks' second-level arrays have been allocated.
+	 */
+	static uint64_t memory(uint64_t numConf, uint64_t nBlocks);
+
+	bool contains(uint64_t conf);
+	bool testAndSet(uint64_t conf);
+	void prefetch(uint64_t conf);
+	uint64_t memory();
+	const char * name() { return "dense"; }
+};
+
+/**
+ * Hash table of configuration numbers. The table is split into SHARDS independent shards,
+ * selected by the upper bits of the hash value of a configuration number. Each shard is an
+ * open addressing hash table with linear probing, which is doubled in size when it is half
+ * full. A shard is protected by its own lock, so that threads inserting into different
+ * shards do not block each other. contains() does not acquire a lock.
+ */
+class SparseVisitedSet : public VisitedSet
+{
+ private:
+	static const uint64_t SHARDBITS = 8;
+	static const uint64_t SHARDS = (1<<SHARDBITS);
+
+	// Marks an empty slot (not a valid configuration number)
+	static const uint64_t EMPTY = ~(uint64_t)0;
+
+	// Initial number of slots of a shard (power of 2)
+	static const uint64_t INITIAL_CAPACITY = 64;
+
+	// One shard of the hash table. The class is aligned to a cache line to avoid false sharing.
+	class alignas(64) Shard {
+	public:
+		std::mutex lock;
+		uint64_t * slots;       // Configuration numbers or EMPTY
+		uint64_t bits;          // Number of slots is 2^bits
+		uint64_t count;         // Number of used slots
+	};
+
+	Shard * shards;
+
+	// Second-level arrays a dense set with the same contents would allocate: bit i is set
+	// if the set contains a configuration c with DenseVisitedSet::bsIndex1(c) == i.
+	// 'nBlocks' is the number of bits set.
+	std::atomic<uint64_t> * blocks;
+	std::atomic<uint64_t> nBlocks;
+
+	// Number of possible configurations
+	uint64_t numConfigs;
+
+	// Hash value of a configuration number (Fibonacci hashing). The upper SHARDBITS bits
+	// select the shard, the following bits the first slot to probe within the shard.
+	static inline uint64_t hash(uint64_t conf) { return conf * 0x9E3779B97F4A7C15ULL; }
+	static inline uint64_t shardOf(uint64_t h) { return h >> (64 - SHARDBITS); }
+	static inline uint64_t slotOf(uint64_t h, uint64_t bits) { return (h << SHARDBITS) >> (64 - bits); }
+
+	// Insert 'conf' into the slots of 'shard' (no check for duplicates, no locking)
+	static void insert(Shard & shard, uint64_t conf);
+
+ public:
+	/**
+	 * Constructor: Create an empty hash table for configuration numbers between 0 and
+	 * numConf-1.
+	 */
+	SparseVisitedSet(uint64_t numConf);
+
+	/**
+	 * Destructur: deallocate memory.
+	 */
+	~SparseVisitedSet();
+
+	bool contains(uint64_t conf);
+	bool testAndSet(uint64_t conf);
+	void prefetch(uint64_t conf);
+	uint64_t memory();
+	const char * name() { return "sparse"; }
+
+	/**
+	 * Return the number of bytes a dense set with the same contents would use.
+	 */
+	uint64_t denseMemory();
+
+	/**
+	 * Create a dense set with the same contents. The method must not be called concurrently
+	 * with testAndSet().
+	 */
+	DenseVisitedSet * toDense();
+};
+
+#endif